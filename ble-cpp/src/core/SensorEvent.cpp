@@ -0,0 +1,78 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#include "SensorEvent.hpp"
+#include "LocException.hpp"
+
+namespace loc{
+    
+    SensorEvent::SensorEvent(const Acceleration& acceleration) : data_(acceleration){}
+    SensorEvent::SensorEvent(const Attitude& attitude) : data_(attitude){}
+    SensorEvent::SensorEvent(const Beacons& beacons) : data_(beacons){}
+    SensorEvent::SensorEvent(const LocalHeading& localHeading) : data_(localHeading){}
+    SensorEvent::SensorEvent(const Altimeter& altimeter) : data_(altimeter){}
+    
+    SensorEvent::Type SensorEvent::type() const{
+        return static_cast<Type>(data_.which());
+    }
+    
+    long SensorEvent::timestamp() const{
+        switch(type()){
+            case ACCELERATION:
+                return acceleration().timestamp();
+            case ATTITUDE:
+                return attitude().timestamp();
+            case BEACONS:
+                return beacons().timestamp();
+            case LOCAL_HEADING:
+                return localHeading().timestamp();
+            case ALTIMETER:
+                return altimeter().timestamp();
+        }
+        BOOST_THROW_EXCEPTION(LocException("unknown sensor event type"));
+    }
+    
+    bool SensorEvent::isIMU() const{
+        return type()==ACCELERATION || type()==ATTITUDE;
+    }
+    
+    const Acceleration& SensorEvent::acceleration() const{
+        return boost::get<Acceleration>(data_);
+    }
+    
+    const Attitude& SensorEvent::attitude() const{
+        return boost::get<Attitude>(data_);
+    }
+    
+    const Beacons& SensorEvent::beacons() const{
+        return boost::get<Beacons>(data_);
+    }
+    
+    const LocalHeading& SensorEvent::localHeading() const{
+        return boost::get<LocalHeading>(data_);
+    }
+    
+    const Altimeter& SensorEvent::altimeter() const{
+        return boost::get<Altimeter>(data_);
+    }
+    
+}
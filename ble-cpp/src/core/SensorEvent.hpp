@@ -0,0 +1,81 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef SensorEvent_hpp
+#define SensorEvent_hpp
+
+#include <stdio.h>
+#include <vector>
+#include <boost/variant.hpp>
+
+#include "Acceleration.hpp"
+#include "Attitude.hpp"
+#include "Beacon.hpp"
+#include "Heading.hpp"
+#include "Altimeter.hpp"
+
+namespace loc{
+    
+    // One input of a StreamLocalizer for the batch API.
+    class SensorEvent{
+    public:
+        enum Type{
+            ACCELERATION,
+            ATTITUDE,
+            BEACONS,
+            LOCAL_HEADING,
+            ALTIMETER
+        };
+        
+        SensorEvent(const Acceleration& acceleration);
+        SensorEvent(const Attitude& attitude);
+        SensorEvent(const Beacons& beacons);
+        SensorEvent(const LocalHeading& localHeading);
+        SensorEvent(const Altimeter& altimeter);
+        ~SensorEvent() = default;
+        
+        Type type() const;
+        long timestamp() const;
+        bool isIMU() const;
+        
+        const Acceleration& acceleration() const;
+        const Attitude& attitude() const;
+        const Beacons& beacons() const;
+        const LocalHeading& localHeading() const;
+        const Altimeter& altimeter() const;
+        
+    private:
+        boost::variant<Acceleration, Attitude, Beacons, LocalHeading, Altimeter> data_;
+    };
+    
+    using SensorEvents = std::vector<SensorEvent>;
+    
+    class SensorBatchOptions{
+    public:
+        bool mergesIMUSamples = true;     // run at most one motion prediction per run of consecutive IMU samples
+        long maxMergedIntervalMS = 1000;  // upper bound of the interval covered by a merged prediction
+        long checkpointIntervalMS = 0;    // interval of update callbacks within a batch (<=0: only at the end)
+    };
+    
+}
+
+#endif /* SensorEvent_hpp */
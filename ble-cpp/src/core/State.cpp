@@ -83,6 +83,20 @@ namespace  loc {
         return *this;
     }
     
+    bool State::cachedMapLabel(int floor, int32_t pixel, uint8_t& label) const{
+        if(mapPixel_==pixel && mapFloor_==floor){
+            label = mapLabel_;
+            return true;
+        }
+        return false;
+    }
+    
+    void State::cacheMapLabel(int floor, int32_t pixel, uint8_t label) const{
+        mapPixel_ = pixel;
+        mapFloor_ = static_cast<int16_t>(floor);
+        mapLabel_ = label;
+    }
+    
     // for string stream
     std::ostream& operator<<(std::ostream&os, const State& state){
         os << state.x() <<"," << state.y() <<"," << state.z() <<"," << state.floor()
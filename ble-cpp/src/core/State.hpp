@@ -43,6 +43,11 @@ namespace loc{
         double negativeLogLikelihood_;
         double mahalanobisDistance_;
         
+        // Map label at the pixel (floor, pixel index) where it was last looked up
+        mutable int32_t mapPixel_ = -1;
+        mutable int16_t mapFloor_ = 0;
+        mutable uint8_t mapLabel_ = 0;
+        
     public:
         using Ptr = std::shared_ptr<State>;
         
@@ -62,6 +67,11 @@ namespace loc{
         State& weight(double weight);
         State& negativeLogLikelihood(double negativeLogLikelihood);
         State& mahalanobisDistance(double mahalanobisDistance);
+        
+        // Returns true and sets the label when a label was cached for the pixel.
+        bool cachedMapLabel(int floor, int32_t pixel, uint8_t& label) const;
+        void cacheMapLabel(int floor, int32_t pixel, uint8_t label) const;
+        
         static State mean(const std::vector<State>& states);
         static State weightedMean(const std::vector<State>& states);
         
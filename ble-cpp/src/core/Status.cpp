@@ -22,6 +22,8 @@
 
 #include "Status.hpp"
 #include "Location.hpp"
+#include <algorithm>
+#include <cmath>
 
 namespace loc{
     
@@ -31,68 +33,201 @@ namespace loc{
     Status::~Status(){}
     
     Status::Status(const Status& status){
-        step_ = status.step_;
-        locationStatus_ = status.locationStatus_;
-        timestamp_ = status.timestamp_;
-        mWasFloorUpdated = status.mWasFloorUpdated;
-        auto meanLoc = status.meanLocation();
-        auto meanPose = status.meanPose();
-        auto states = status.states();
-        if(meanLoc){
-            meanLocation_ = Location::Ptr(new Location(*meanLoc));
-        }
-        if(meanPose){
-            meanPose_ = Pose::Ptr(new Pose(*meanPose));
-        }
-        if(states){
-            states_ = std::shared_ptr<States>(new States(*states));
-        }
+        *this = status;
     }
     
     Status& Status::operator=(const Status& status){
+        if(this == &status){
+            return *this;
+        }
         step_ = status.step_;
         locationStatus_ = status.locationStatus_;
         timestamp_ = status.timestamp_;
         mWasFloorUpdated = status.mWasFloorUpdated;
-        auto meanLoc = status.meanLocation();
-        auto meanPose = status.meanPose();
-        auto states = status.states();
-        if(meanLoc){
-            meanLocation_ = Location::Ptr(new Location(*meanLoc));
+        Location::Ptr meanLocation;
+        Pose::Ptr meanPose;
+        std::shared_ptr<const Moments> moments;
+        {
+            std::lock_guard<std::mutex> lock(status.momentsMutex_);
+            meanLocation = status.meanLocation_;
+            meanPose = status.meanPose_;
+            moments = status.moments_;
+        }
+        std::lock_guard<std::mutex> lock(momentsMutex_);
+        meanLocation_.reset();
+        meanPose_.reset();
+        if(meanLocation){
+            meanLocation_ = Location::Ptr(new Location(*meanLocation));
         }
         if(meanPose){
             meanPose_ = Pose::Ptr(new Pose(*meanPose));
         }
-        if(states){
-            states_ = std::shared_ptr<States>(new States(*states));
-        }
+        // States and moments are immutable while shared. A writer obtains its own copy through mutableStates().
+        states_ = status.states_;
+        moments_ = moments;
+        hasMoments_ = status.hasMoments_;
         return *this;
     }
     
     std::shared_ptr<Location> Status::meanLocation() const{
+        std::lock_guard<std::mutex> lock(momentsMutex_);
+        if(!meanLocation_ && hasMoments_){
+            meanLocation_ = std::make_shared<Location>(momentsLocked()->meanLocation);
+        }
         return meanLocation_;
     }
     
     std::shared_ptr<Pose> Status::meanPose() const{
+        std::lock_guard<std::mutex> lock(momentsMutex_);
+        if(!meanPose_ && hasMoments_){
+            meanPose_ = std::make_shared<Pose>(momentsLocked()->meanPose);
+        }
         return meanPose_;
     }
     
+    std::shared_ptr<const Status::Moments> Status::moments() const{
+        std::lock_guard<std::mutex> lock(momentsMutex_);
+        return momentsLocked();
+    }
+    
+    const std::shared_ptr<const Status::Moments>& Status::momentsLocked() const{
+        if(!moments_){
+            moments_ = computeMoments(*states_);
+        }
+        return moments_;
+    }
+    
+    void Status::invalidateMoments(){
+        std::lock_guard<std::mutex> lock(momentsMutex_);
+        moments_.reset();
+        meanLocation_.reset();
+        meanPose_.reset();
+    }
+    
+    std::shared_ptr<const Status::Moments> Status::computeMoments(const std::vector<State>& states){
+        auto m = std::make_shared<Moments>();
+        size_t n = states.size();
+        if(n==0){
+            return m;
+        }
+        
+        // The states are weighted uniformly if their weights do not sum to a positive value.
+        double sumWeights = 0;
+        for(const State& s: states){
+            sumWeights += s.weight();
+        }
+        bool isUniform = !(0 < sumWeights);
+        
+        // Second moments are accumulated around the first state to limit cancellation.
+        double x0 = states[0].x();
+        double y0 = states[0].y();
+        double z0 = states[0].z();
+        double f0 = states[0].floor();
+        double sumW = 0;
+        double wx = 0, wy = 0, wz = 0, wf = 0;
+        double wxx = 0, wxy = 0, wyy = 0;
+        double vxm = 0, vym = 0, vxrepm = 0, vyrepm = 0;
+        double wcos = 0, wsin = 0;
+        double sx = 0, sy = 0, sz = 0, sf = 0;
+        double sxx = 0, syy = 0, szz = 0, sff = 0, sxy = 0;
+        double bcos = 0, bsin = 0;
+        for(const State& s: states){
+            double w = isUniform? 1.0 : s.weight();
+            double dx = s.x() - x0;
+            double dy = s.y() - y0;
+            double dz = s.z() - z0;
+            double df = s.floor() - f0;
+            double c = std::cos(s.orientation());
+            double sn = std::sin(s.orientation());
+            
+            sumW += w;
+            wx += w*dx;
+            wy += w*dy;
+            wz += w*dz;
+            wf += w*df;
+            wxx += w*dx*dx;
+            wxy += w*dx*dy;
+            wyy += w*dy*dy;
+            vxm += w*s.velocity()*c;
+            vym += w*s.velocity()*sn;
+            vxrepm += w*s.normalVelocity()*c;
+            vyrepm += w*s.normalVelocity()*sn;
+            wcos += w*c;
+            wsin += w*sn;
+            m->floorProbabilities[(int) std::round(s.floor())] += w;
+            
+            sx += dx;
+            sy += dy;
+            sz += dz;
+            sf += df;
+            sxx += dx*dx;
+            syy += dy*dy;
+            szz += dz*dz;
+            sff += df*df;
+            sxy += dx*dy;
+            bcos += std::cos(s.orientationBias());
+            bsin += std::sin(s.orientationBias());
+        }
+        
+        // weighted statistics
+        double mx = wx/sumW, my = wy/sumW, mz = wz/sumW, mf = wf/sumW;
+        m->meanLocation = Location(x0+mx, y0+my, z0+mz, f0+mf);
+        vxm /= sumW;
+        vym /= sumW;
+        vxrepm /= sumW;
+        vyrepm /= sumW;
+        m->meanPose.x(x0+mx).y(y0+my).z(z0+mz).floor(f0+mf);
+        m->meanPose.orientation(std::atan2(vyrepm, vxrepm)) // orientation must be calculated by representative velocity.
+        .velocity(std::sqrt(vxm*vxm + vym*vym))
+        .normalVelocity(std::sqrt(vxrepm*vxrepm + vyrepm*vyrepm));
+        m->covarianceXX = wxx/sumW - mx*mx;
+        m->covarianceXY = wxy/sumW - mx*my;
+        m->covarianceYY = wyy/sumW - my*my;
+        m->orientationMean = std::atan2(wsin, wcos);
+        m->orientationConcentration = std::sqrt(wcos*wcos + wsin*wsin)/sumW;
+        for(auto& fp: m->floorProbabilities){
+            fp.second /= sumW;
+        }
+        
+        // unweighted statistics
+        double ux = sx/n, uy = sy/n, uz = sz/n, uf = sf/n;
+        double varx = std::max(sxx/n - ux*ux, 0.0);
+        double vary = std::max(syy/n - uy*uy, 0.0);
+        double varz = std::max(szz/n - uz*uz, 0.0);
+        double varf = std::max(sff/n - uf*uf, 0.0);
+        double covxy = sxy/n - ux*uy;
+        m->stdevLocation = Location(std::sqrt(varx), std::sqrt(vary), std::sqrt(varz), std::sqrt(varf));
+        m->variance2D = varx*vary - covxy*covxy;
+        
+        double R = std::sqrt(bcos*bcos + bsin*bsin)/n;
+        double sigma = 0;
+        if(1<n){
+            double R2 = R*R>1.0/n? R*R : 1.0/n;
+            double Re2 = (double)n/(n-1)*(R2 - 1.0/n);
+            double sigma2 = std::log(1.0/Re2);
+            sigma = sigma2>0? std::sqrt(sigma2) : 0.0;
+        }
+        m->orientationBias = WrappedNormalParameter(std::atan2(bsin, bcos), sigma);
+        return m;
+    }
+    
     long Status::timestamp() const{
         return timestamp_;
     }
     
-    std::shared_ptr<std::vector<State>> Status::states() const{
+    std::shared_ptr<const std::vector<State>> Status::states() const{
         return states_;
     }
     
-    Status& Status::meanLocation(std::shared_ptr<Location> location){
-        meanLocation_ = location;
-        return *this;
-    }
-    
-    Status& Status::meanPose(std::shared_ptr<Pose> pose){
-        meanPose_ = pose;
-        return *this;
+    std::shared_ptr<std::vector<State>> Status::mutableStates(){
+        if(!states_){
+            return nullptr;
+        }
+        if(states_.use_count() > 1){
+            states_ = std::make_shared<States>(*states_);
+        }
+        invalidateMoments();
+        return std::const_pointer_cast<States>(states_);
     }
     
     Status& Status::timestamp(long timestamp){
@@ -106,24 +241,17 @@ namespace loc{
         return this->states(statesTmp);
     }
     
-    Status& Status::states(std::shared_ptr<std::vector<State>> states){
+    Status& Status::states(std::shared_ptr<const std::vector<State>> states){
         this->step(Status::OTHER);
         
         states_ = states;
-        size_t n = states->size();
-        std::vector<double> weights(n);
-        for(int i=0; i<n; i++){
-            weights[i] = states->at(i).weight();
-        }
-        // Compute mean Location
-        auto meanLoc = std::shared_ptr<Location>(new Location(Location::weightedMean(*states, weights)));
-        meanLocation(meanLoc);
-        auto meanPs = std::shared_ptr<Pose>(new Pose(Pose::weightedMean(*states, weights)));
-        meanPose(meanPs);
+        // Moments are computed on demand.
+        invalidateMoments();
+        hasMoments_ = true;
         return *this;
     }
     
-    Status& Status::states(std::shared_ptr<std::vector<State>> states, Step step){
+    Status& Status::states(std::shared_ptr<const std::vector<State>> states, Step step){
         this->states(states);
         this->step(step);
         return *this;
@@ -24,7 +24,9 @@
 
 #include <iostream>
 #include <vector>
+#include <map>
 #include <memory>
+#include <mutex>
 
 
 #include "Location.hpp"
@@ -39,7 +41,7 @@ namespace loc{
         Status();
         ~Status();
         
-        // copy constructor
+        // copy constructor (particles are shared, not copied)
         Status(const Status& s);
         Status& operator=(const Status& s);
         
@@ -60,10 +62,28 @@ namespace loc{
             NIL
         };
         
+        // Statistics of the states computed together in a single pass.
+        struct Moments{
+            Location meanLocation;  // weighted
+            Pose meanPose;          // weighted
+            Location stdevLocation; // unweighted (same as Location::standardDeviation)
+            double variance2D = 0;  // unweighted (same as Location::compute2DVariance)
+            double covarianceXX = 0, covarianceXY = 0, covarianceYY = 0; // weighted
+            double orientationMean = 0, orientationConcentration = 0;    // weighted circular mean and mean resultant length
+            WrappedNormalParameter orientationBias{0, 0}; // unweighted (same as MathUtils::computeWrappedNormalParameters)
+            std::map<int, double> floorProbabilities;     // weighted, by rounded floor
+        };
+        
         std::shared_ptr<Location> meanLocation() const;
         std::shared_ptr<Pose> meanPose() const;
+        // Computed on first access and cached until the states are replaced or modified.
+        // The lazy computation is thread-safe, so a published Status can be read from several threads.
+        // The returned moments stay valid after the states are modified.
+        std::shared_ptr<const Moments> moments() const;
         long timestamp() const;
-        std::shared_ptr<std::vector<State>> states() const;
+        std::shared_ptr<const std::vector<State>> states() const;
+        // Returns states that can be modified in place. The states are copied first if they are shared with another Status (copy-on-write).
+        std::shared_ptr<std::vector<State>> mutableStates();
         Step step() const;
         LocationStatus locationStatus() const;
         
@@ -72,8 +92,8 @@ namespace loc{
         [[deprecated("please use states(std::shared_ptr<std::vector<State>>) function")]]
         Status& states(std::vector<State>* states);
         
-        Status& states(std::shared_ptr<std::vector<State>> states);
-        Status& states(std::shared_ptr<std::vector<State>> states, Step step);
+        Status& states(std::shared_ptr<const std::vector<State>> states);
+        Status& states(std::shared_ptr<const std::vector<State>> states, Step step);
         Status& step(Step step);
         Status& locationStatus(LocationStatus locationStatus);
         
@@ -87,13 +107,17 @@ namespace loc{
         Step step_ = Step::OTHER;
         LocationStatus locationStatus_ = NIL;
         //LocationStatus locationStatus_ = UNKNOWN;
-        std::shared_ptr<Location> meanLocation_;
-        std::shared_ptr<Pose> meanPose_;
-        std::shared_ptr<std::vector<State>> states_;
+        mutable std::shared_ptr<Location> meanLocation_;
+        mutable std::shared_ptr<Pose> meanPose_;
+        mutable std::shared_ptr<const Moments> moments_;
+        mutable std::mutex momentsMutex_; // guards meanLocation_, meanPose_ and moments_
+        std::shared_ptr<const std::vector<State>> states_;
+        bool hasMoments_ = false;
         bool mWasFloorUpdated = false;
         
-        Status& meanLocation(std::shared_ptr<Location> location);
-        Status& meanPose(std::shared_ptr<Pose> pose);
+        void invalidateMoments();
+        const std::shared_ptr<const Moments>& momentsLocked() const;
+        static std::shared_ptr<const Moments> computeMoments(const std::vector<State>& states);
         
     };
     
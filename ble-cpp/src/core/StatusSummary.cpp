@@ -0,0 +1,97 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#include "StatusSummary.hpp"
+
+namespace loc{
+    
+    StatusSummary StatusSummary::fromStatus(const Status& status, bool includesStates){
+        StatusSummary summary;
+        summary.timestamp_ = status.timestamp();
+        summary.locationStatus_ = status.locationStatus();
+        summary.step_ = status.step();
+        if(status.meanPose()){
+            summary.meanPose_ = *status.meanPose();
+        }
+        
+        if(includesStates){
+            summary.states_ = status.states();
+        }
+        if(status.states()->size()==0){
+            return summary;
+        }
+        
+        const auto& moments = status.moments();
+        summary.covXX_ = moments.covarianceXX;
+        summary.covXY_ = moments.covarianceXY;
+        summary.covYY_ = moments.covarianceYY;
+        summary.floorProbabilities_ = moments.floorProbabilities;
+        summary.orientationMean_ = moments.orientationMean;
+        summary.orientationConcentration_ = moments.orientationConcentration;
+        return summary;
+    }
+    
+    long StatusSummary::timestamp() const{
+        return timestamp_;
+    }
+    
+    const Pose& StatusSummary::meanPose() const{
+        return meanPose_;
+    }
+    
+    double StatusSummary::covarianceXX() const{
+        return covXX_;
+    }
+    
+    double StatusSummary::covarianceXY() const{
+        return covXY_;
+    }
+    
+    double StatusSummary::covarianceYY() const{
+        return covYY_;
+    }
+    
+    const std::map<int, double>& StatusSummary::floorProbabilities() const{
+        return floorProbabilities_;
+    }
+    
+    double StatusSummary::orientationMean() const{
+        return orientationMean_;
+    }
+    
+    double StatusSummary::orientationConcentration() const{
+        return orientationConcentration_;
+    }
+    
+    Status::LocationStatus StatusSummary::locationStatus() const{
+        return locationStatus_;
+    }
+    
+    Status::Step StatusSummary::step() const{
+        return step_;
+    }
+    
+    std::shared_ptr<const States> StatusSummary::states() const{
+        return states_;
+    }
+    
+}
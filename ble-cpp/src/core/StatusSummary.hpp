@@ -0,0 +1,81 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef StatusSummary_hpp
+#define StatusSummary_hpp
+
+#include <stdio.h>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "Pose.hpp"
+#include "State.hpp"
+#include "Status.hpp"
+
+namespace loc{
+    
+    /**
+     Compact summary of a Status for consumers that do not need the particles.
+     **/
+    class StatusSummary{
+    public:
+        using Ptr = std::shared_ptr<StatusSummary>;
+        
+        StatusSummary() = default;
+        ~StatusSummary() = default;
+        
+        // Particles are shared with the status (not copied) only when includesStates is true.
+        static StatusSummary fromStatus(const Status& status, bool includesStates = false);
+        
+        long timestamp() const;
+        const Pose& meanPose() const;
+        // weighted covariance of (x, y)
+        double covarianceXX() const;
+        double covarianceXY() const;
+        double covarianceYY() const;
+        // weight of the particles on each (rounded) floor
+        const std::map<int, double>& floorProbabilities() const;
+        // circular mean of the particle orientations and its mean resultant length in [0, 1]
+        double orientationMean() const;
+        double orientationConcentration() const;
+        Status::LocationStatus locationStatus() const;
+        Status::Step step() const;
+        std::shared_ptr<const States> states() const;
+        
+    private:
+        long timestamp_ = 0;
+        Pose meanPose_;
+        double covXX_ = 0;
+        double covXY_ = 0;
+        double covYY_ = 0;
+        std::map<int, double> floorProbabilities_;
+        double orientationMean_ = 0;
+        double orientationConcentration_ = 0;
+        Status::LocationStatus locationStatus_ = Status::NIL;
+        Status::Step step_ = Status::OTHER;
+        std::shared_ptr<const States> states_;
+    };
+    
+}
+
+#endif /* StatusSummary_hpp */
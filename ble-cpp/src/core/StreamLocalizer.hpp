@@ -27,6 +27,7 @@
 #include "bleloc.h"
 #include "Altimeter.hpp"
 #include "Heading.hpp"
+#include "SensorEvent.hpp"
 
 namespace loc {
     class StreamLocalizer{
@@ -43,6 +44,31 @@ namespace loc {
         virtual StreamLocalizer& putAltimeter(const Altimeter altimeter) = 0;
         virtual Status* getStatus() = 0;
         
+        // Inputs a time-ordered batch of sensor events. Implementations may merge IMU samples and
+        // call the update handlers only at checkpoints and at the end of the batch.
+        virtual StreamLocalizer& putSensorEvents(const SensorEvents& events, const SensorBatchOptions& options){
+            for(const auto& event: events){
+                putSensorEvent(event);
+            }
+            return *this;
+        }
+        
+        StreamLocalizer& putSensorEvent(const SensorEvent& event){
+            switch(event.type()){
+                case SensorEvent::ACCELERATION:
+                    return putAcceleration(event.acceleration());
+                case SensorEvent::ATTITUDE:
+                    return putAttitude(event.attitude());
+                case SensorEvent::BEACONS:
+                    return putBeacons(event.beacons());
+                case SensorEvent::LOCAL_HEADING:
+                    return putLocalHeading(event.localHeading());
+                case SensorEvent::ALTIMETER:
+                    return putAltimeter(event.altimeter());
+            }
+            return *this;
+        }
+        
         virtual bool resetStatus() = 0;
         virtual bool resetStatus(Pose pose) = 0;
         virtual bool resetStatus(Pose meanPose, Pose stdevPose) = 0;
@@ -27,6 +27,7 @@
 
 #include <iostream>
 #include <string>
+#include <atomic>
 
 #include "Sample.hpp"
 #include "BLEBeacon.hpp"
@@ -47,6 +48,25 @@ public:
     virtual const Building& getBuilding() const = 0;
     
     virtual const Locations& getLocations() const = 0;
+    
+    // Changes whenever the contents change. Data derived from the contents can be cached with it.
+    unsigned long generation() const{
+        return mGeneration;
+    }
+    
+protected:
+    void updateGeneration() const{
+        mGeneration = nextGeneration();
+    }
+    
+private:
+    mutable unsigned long mGeneration = nextGeneration();
+    
+    // Generations are unique across instances.
+    static unsigned long nextGeneration(){
+        static std::atomic<unsigned long> counter(0);
+        return ++counter;
+    }
 };
     
 }
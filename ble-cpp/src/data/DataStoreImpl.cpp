@@ -31,27 +31,33 @@ namespace loc{
     
     void DataStoreImpl::readSamples(std::istream &is){
         DataUtils::csvSamplesToSamples(is, mSamples);
+        updateGeneration();
     }
     void DataStoreImpl::readSamples(std::istream &is, bool noBeacons){
         DataUtils::csvSamplesToSamples(is, mSamples, noBeacons);
+        updateGeneration();
     }
     DataStoreImpl& DataStoreImpl::samples(Samples samples){
         mSamples = samples;
+        updateGeneration();
         return *this;
     }
     
     DataStoreImpl& DataStoreImpl::bleBeacons(BLEBeacons bleBeacons){
         mBLEBeacons = bleBeacons;
+        updateGeneration();
         return *this;
     }
     
     DataStoreImpl& DataStoreImpl::building(Building building){
         mBuilding = building;
+        updateGeneration();
         return *this;
     }
     
     DataStoreImpl& DataStoreImpl::locations(Locations locations){
         mLocations = locations;
+        updateGeneration();
         return *this;
     }
     
@@ -70,6 +76,7 @@ namespace loc{
     const Locations& DataStoreImpl::getLocations() const{
         if(mLocations.size()==0){
             mLocations = Sample::extractUniqueLocations(mSamples);
+            updateGeneration();
         }
         return mLocations;
     }
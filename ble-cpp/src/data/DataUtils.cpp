@@ -24,6 +24,7 @@
 #include <string>
 #include <algorithm>
 #include <regex>
+#include <iterator>
 
 #include "Location.hpp"
 #include "Beacon.hpp"
@@ -311,6 +312,27 @@ namespace loc{
         return tempPath;
     }
     
+    std::string DataUtils::dataURIToBytes(const std::string& dataStr, std::string* type){
+        // Only the header is matched so that long payloads are not scanned by the regex.
+        size_t comma = dataStr.find(',');
+        std::string header = comma==std::string::npos ? "" : dataStr.substr(0, comma+1);
+        std::smatch match;
+        if(!std::regex_match(header, match, std::regex("^data:([a-z]+/[a-z]+);base64,$"))){
+            BOOST_THROW_EXCEPTION(LocException("Data is not a base64 data URI."));
+        }
+        if(type){
+            *type = std::regex_replace(std::string(match[1]), std::regex("^[^/]+/(x-)?"), "");
+        }
+        auto end = dataStr.end();
+        while(comma+1 < static_cast<size_t>(end - dataStr.begin()) && *(end-1)=='='){
+            end--;
+        }
+        std::string bytes;
+        bytes.reserve((end - dataStr.begin() - comma - 1)*3/4);
+        std::copy(it_binary_t(dataStr.begin()+comma+1), it_binary_t(end), std::back_inserter(bytes));
+        return bytes;
+    }
+    
     Location DataUtils::parseLocationCSV(const std::string& csvLine){
         
         std::list<std::string> stringList = splitAndTrimCSV(csvLine);
@@ -623,11 +645,11 @@ namespace loc{
     }
     
     
-    picojson::object DataUtils::statusToJSONObject(Status status, bool optOutputStates){
+    picojson::object DataUtils::statusToJSONObject(const Status& status, bool optOutputStates){
         std::shared_ptr<Location> meanLocation = status.meanLocation();
         std::shared_ptr<Pose> meanPose = status.meanPose();
-        std::shared_ptr<std::vector<State>> states = status.states();
-        Location stdevLocation = Location::standardDeviation(*states);
+        auto states = status.states();
+        Location stdevLocation = status.moments()->stdevLocation;
         
         picojson::object json;
         if(meanPose){
@@ -62,6 +62,8 @@ namespace loc{
         
         static std::string fileToString(const std::string& filePath);
         static std::string stringToFile(const std::string& dataStr, const std::string& dir, const std::string& file = "");
+        // Decodes a base64 data URI (data:<mime type>;base64,...). type is set to the subtype (e.g. png) when given.
+        static std::string dataURIToBytes(const std::string& dataStr, std::string* type = nullptr);
         
         static Location parseLocationCSV(const std::string& csvLine);
         static Sample parseSampleCSV(const std::string& csvLine)  throw (std::invalid_argument);
@@ -92,7 +94,7 @@ namespace loc{
         static picojson::object stateToJSONObject(State state);
         static picojson::array statesToJSONArray(std::vector<State> states);
         static picojson::array statesToJSONArrayLight(std::vector<State> states);
-        static picojson::object statusToJSONObject(Status status, bool optOutputStates);
+        static picojson::object statusToJSONObject(const Status& status, bool optOutputStates);
         
         static picojson::array beaconsToJSONArray(const Beacons& beacons);
         
@@ -31,16 +31,21 @@ namespace loc{
     
     LazyDataStore& LazyDataStore::samplesFilePathes(std::vector<std::string> samplesFilePathes){
         mSamplesFilePathes = samplesFilePathes;
+        samples.clear();
+        updateGeneration();
         return *this;
     }
     
     LazyDataStore& LazyDataStore::bleBeaconsFilePathes(std::vector<std::string> bleBeaconsFilePathes){
         mBLEBeaconsFilePathes = bleBeaconsFilePathes;
+        bleBeacons.clear();
+        updateGeneration();
         return *this;
     }
     
     LazyDataStore& LazyDataStore::building(Building building){
         mBuilding = building;
+        updateGeneration();
         return *this;
     }
     
@@ -52,6 +57,7 @@ namespace loc{
                 Samples samplesTmp = DataUtils::csvSamplesToSamples(istream);
                 samples.insert(samples.end(), samplesTmp.begin(), samplesTmp.end());
             }
+            updateGeneration();
         }
         return samples;
     }
@@ -64,6 +70,7 @@ namespace loc{
                 BLEBeacons bleBeaconsTmp = DataUtils::csvBLEBeaconsToBLEBeacons(bleBeaconIStream);
                 bleBeacons.insert(bleBeacons.end(), bleBeaconsTmp.begin(), bleBeaconsTmp.end());
             }
+            updateGeneration();
         }
         return bleBeacons;
     }
@@ -0,0 +1,371 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#include "ParticleTraceRecorder.hpp"
+#include <cstring>
+#include <fstream>
+#include <unistd.h>
+
+#include "bleloc.h"
+
+namespace loc{
+    
+    namespace{
+        const char kMagic[4] = {'P', 'T', 'R', 'C'};
+        const uint32_t kVersion = 1;
+        const size_t kMaxFrameHeaderBytes = 1 + 10 + 4;
+        
+        // IEEE 754 binary32 -> binary16 with round-to-nearest-even
+        uint16_t floatToHalf(float value){
+            uint32_t f;
+            std::memcpy(&f, &value, sizeof(f));
+            uint32_t sign = (f >> 16) & 0x8000;
+            int32_t exponent = ((f >> 23) & 0xff) - 127 + 15;
+            uint32_t mantissa = f & 0x7fffff;
+            if(((f >> 23) & 0xff) == 0xff){ // inf or nan
+                return sign | 0x7c00 | (mantissa ? 0x200 : 0);
+            }
+            if(exponent >= 0x1f){ // overflow
+                return sign | 0x7c00;
+            }
+            if(exponent <= 0){ // subnormal or zero
+                if(exponent < -10){
+                    return sign;
+                }
+                mantissa |= 0x800000;
+                uint32_t shift = 14 - exponent;
+                uint32_t half = mantissa >> shift;
+                uint32_t rest = mantissa & ((1u << shift) - 1);
+                uint32_t halfway = 1u << (shift - 1);
+                if(rest > halfway || (rest == halfway && (half & 1))){
+                    half++;
+                }
+                return sign | half;
+            }
+            uint32_t half = sign | (exponent << 10) | (mantissa >> 13);
+            uint32_t rest = mantissa & 0x1fff;
+            if(rest > 0x1000 || (rest == 0x1000 && (half & 1))){
+                half++; // may carry into the exponent, which is the correct rounding
+            }
+            return half;
+        }
+        
+        float halfToFloat(uint16_t h){
+            uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+            uint32_t exponent = (h >> 10) & 0x1f;
+            uint32_t mantissa = h & 0x3ff;
+            uint32_t f;
+            if(exponent == 0){
+                if(mantissa == 0){
+                    f = sign;
+                }else{ // subnormal
+                    exponent = 127 - 15 + 1;
+                    while(!(mantissa & 0x400)){
+                        mantissa <<= 1;
+                        exponent--;
+                    }
+                    mantissa &= 0x3ff;
+                    f = sign | (exponent << 23) | (mantissa << 13);
+                }
+            }else if(exponent == 0x1f){
+                f = sign | 0x7f800000 | (mantissa << 13);
+            }else{
+                f = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+            }
+            float value;
+            std::memcpy(&value, &f, sizeof(value));
+            return value;
+        }
+        
+        // Multi-byte values are stored in the native byte order, which is little endian on all supported platforms.
+        template<class T>
+        void put(std::vector<uint8_t>& buf, T value){
+            size_t pos = buf.size();
+            buf.resize(pos + sizeof(T));
+            std::memcpy(&buf[pos], &value, sizeof(T));
+        }
+        
+        void putVarint(std::vector<uint8_t>& buf, int64_t value){
+            uint64_t zz = ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+            while(zz >= 0x80){
+                buf.push_back((uint8_t)(zz | 0x80));
+                zz >>= 7;
+            }
+            buf.push_back((uint8_t)zz);
+        }
+        
+        template<class T>
+        bool get(std::istream& is, T& value){
+            return (bool) is.read(reinterpret_cast<char*>(&value), sizeof(T));
+        }
+        
+        bool getVarint(std::istream& is, int64_t& value){
+            uint64_t zz = 0;
+            int shift = 0;
+            int c;
+            do{
+                c = is.get();
+                if(c == EOF || shift > 63){
+                    return false;
+                }
+                zz |= (uint64_t)(c & 0x7f) << shift;
+                shift += 7;
+            }while(c & 0x80);
+            value = (int64_t)(zz >> 1) ^ -(int64_t)(zz & 1);
+            return true;
+        }
+    }
+    
+    ParticleTraceRecorder::ParticleTraceRecorder(const std::string& filePath)
+    : ParticleTraceRecorder(filePath, Parameters())
+    {}
+    
+    ParticleTraceRecorder::ParticleTraceRecorder(const std::string& filePath, Parameters params)
+    : mParams(params)
+    {
+        mFile = std::fopen(filePath.c_str(), "wb");
+        if(!mFile){
+            BOOST_THROW_EXCEPTION(LocException("failed to open particle trace file: " + filePath));
+        }
+        if(0 < mParams.preallocatedBytes){
+            if(ftruncate(fileno(mFile), mParams.preallocatedBytes) != 0){
+                std::cerr << "failed to preallocate particle trace file: " << filePath << std::endl;
+            }
+        }
+        uint32_t flags = mParams.usesHalfPrecisionPosition ? HALF_PRECISION_POSITION : 0;
+        std::fwrite(kMagic, 1, sizeof(kMagic), mFile);
+        std::fwrite(&kVersion, sizeof(kVersion), 1, mFile);
+        std::fwrite(&flags, sizeof(flags), 1, mFile);
+        mBytesWritten = sizeof(kMagic) + sizeof(kVersion) + sizeof(flags);
+        mWriter = std::thread(&ParticleTraceRecorder::run, this);
+    }
+    
+    ParticleTraceRecorder::~ParticleTraceRecorder(){
+        close();
+    }
+    
+    void ParticleTraceRecorder::record(const States& states, FrameKind kind, long timestamp){
+        size_t n = states.size();
+        if(n == 0){
+            return; // an empty frame marks the end of data in a preallocated file
+        }
+        size_t positionBytes = mParams.usesHalfPrecisionPosition ? sizeof(uint16_t) : sizeof(float);
+        size_t frameBytes = kMaxFrameHeaderBytes + n*(4*positionBytes + 8*sizeof(float));
+        
+        Buffer buf;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            if(!mRunning || mParams.maxBufferedBytes < mPendingBytes + frameBytes){
+                mFramesDropped++;
+                return;
+            }
+            if(!mFreeBuffers.empty()){
+                buf = std::move(mFreeBuffers.back());
+                mFreeBuffers.pop_back();
+            }
+        }
+        
+        buf.clear();
+        buf.reserve(frameBytes);
+        put<uint8_t>(buf, (uint8_t) kind);
+        putVarint(buf, timestamp - mPreviousTimestamp);
+        put<uint32_t>(buf, (uint32_t) n);
+        for(const State& s: states){
+            if(mParams.usesHalfPrecisionPosition){
+                put<uint16_t>(buf, floatToHalf(s.x()));
+                put<uint16_t>(buf, floatToHalf(s.y()));
+                put<uint16_t>(buf, floatToHalf(s.z()));
+                put<uint16_t>(buf, floatToHalf(s.floor()));
+            }else{
+                put<float>(buf, s.x());
+                put<float>(buf, s.y());
+                put<float>(buf, s.z());
+                put<float>(buf, s.floor());
+            }
+            put<float>(buf, s.orientation());
+            put<float>(buf, s.velocity());
+            put<float>(buf, s.normalVelocity());
+            put<float>(buf, s.orientationBias());
+            put<float>(buf, s.rssiBias());
+            put<float>(buf, s.weight());
+            put<float>(buf, s.negativeLogLikelihood());
+            put<float>(buf, s.mahalanobisDistance());
+        }
+        mPreviousTimestamp = timestamp;
+        
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mPendingBytes += buf.size();
+            mPending.push_back(std::move(buf));
+        }
+        mCV.notify_one();
+    }
+    
+    void ParticleTraceRecorder::run(){
+        std::unique_lock<std::mutex> lock(mMutex);
+        while(true){
+            mCV.wait(lock, [this]{
+                return !mPending.empty() || !mRunning;
+            });
+            if(mPending.empty()){
+                break; // stopped and drained
+            }
+            Buffer buf = std::move(mPending.front());
+            mPending.pop_front();
+            mWriting = true;
+            lock.unlock();
+            
+            size_t written = std::fwrite(buf.data(), 1, buf.size(), mFile);
+            
+            lock.lock();
+            mBytesWritten += written;
+            mPendingBytes -= buf.size();
+            if(written == buf.size()){
+                mFramesWritten++;
+            }else{
+                mFramesDropped++;
+            }
+            // Keep a few buffers to avoid reallocating them for every frame.
+            if(mFreeBuffers.size() < 4){
+                mFreeBuffers.push_back(std::move(buf));
+            }
+            mWriting = false;
+            mFlushedCV.notify_all();
+        }
+    }
+    
+    void ParticleTraceRecorder::flush(){
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mFlushedCV.wait(lock, [this]{
+                return mPending.empty() && !mWriting;
+            });
+        }
+        if(mFile){
+            std::fflush(mFile);
+        }
+    }
+    
+    void ParticleTraceRecorder::close(){
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mRunning = false;
+        }
+        mCV.notify_one();
+        if(mWriter.joinable()){
+            mWriter.join();
+        }
+        if(mFile){
+            std::fflush(mFile);
+            if(0 < mParams.preallocatedBytes){
+                if(ftruncate(fileno(mFile), mBytesWritten) != 0){
+                    std::cerr << "failed to trim particle trace file" << std::endl;
+                }
+            }
+            std::fclose(mFile);
+            mFile = NULL;
+        }
+    }
+    
+    long ParticleTraceRecorder::nFramesWritten() const{
+        return mFramesWritten;
+    }
+    
+    long ParticleTraceRecorder::nFramesDropped() const{
+        return mFramesDropped;
+    }
+    
+    std::string ParticleTraceRecorder::frameKindToString(FrameKind kind){
+        switch(kind){
+            case BEFORE_LIKELIHOOD:
+                return "before_likelihood";
+            case AFTER_LIKELIHOOD:
+                return "after_likelihood";
+            case RESAMPLED:
+                return "resampled";
+            default:
+                return "other";
+        }
+    }
+    
+    void ParticleTraceRecorder::convertToCSV(const std::string& tracePath, const std::string& csvPath){
+        std::ifstream ifs(tracePath, std::ios::binary);
+        if(!ifs){
+            BOOST_THROW_EXCEPTION(LocException("failed to open particle trace file: " + tracePath));
+        }
+        char magic[4];
+        uint32_t version, flags;
+        if(!ifs.read(magic, sizeof(magic)) || std::memcmp(magic, kMagic, sizeof(kMagic)) != 0
+           || !get(ifs, version) || version != kVersion || !get(ifs, flags)){
+            BOOST_THROW_EXCEPTION(LocException("invalid particle trace file: " + tracePath));
+        }
+        bool halfPrecision = flags & HALF_PRECISION_POSITION;
+        
+        std::ofstream ofs(csvPath);
+        ofs << "timestamp,kind,index," << State().header() << std::endl;
+        
+        long timestamp = 0;
+        while(true){
+            uint8_t kind;
+            int64_t delta;
+            uint32_t n;
+            if(!get(ifs, kind) || !getVarint(ifs, delta) || !get(ifs, n) || n == 0){
+                break;
+            }
+            timestamp += delta;
+            std::string kindStr = frameKindToString((FrameKind) kind);
+            for(uint32_t i=0; i<n; i++){
+                float pos[4];
+                if(halfPrecision){
+                    uint16_t h[4];
+                    if(!ifs.read(reinterpret_cast<char*>(h), sizeof(h))){
+                        return;
+                    }
+                    for(int j=0; j<4; j++){
+                        pos[j] = halfToFloat(h[j]);
+                    }
+                }else if(!ifs.read(reinterpret_cast<char*>(pos), sizeof(pos))){
+                    return;
+                }
+                float v[8];
+                if(!ifs.read(reinterpret_cast<char*>(v), sizeof(v))){
+                    return;
+                }
+                State s;
+                s.x(pos[0]);
+                s.y(pos[1]);
+                s.z(pos[2]);
+                s.floor(pos[3]);
+                s.orientation(v[0]);
+                s.velocity(v[1]);
+                s.normalVelocity(v[2]);
+                s.orientationBias(v[3]);
+                s.rssiBias(v[4]);
+                s.weight(v[5]);
+                s.negativeLogLikelihood(v[6]);
+                s.mahalanobisDistance(v[7]);
+                ofs << timestamp << "," << kindStr << "," << i << "," << s << "\n";
+            }
+        }
+    }
+    
+}
@@ -0,0 +1,118 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef ParticleTraceRecorder_hpp
+#define ParticleTraceRecorder_hpp
+
+#include <stdio.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "State.hpp"
+
+namespace loc{
+    
+    /**
+     Records particle sets as compact binary frames appended to a single file by a background writer thread.
+     Frames are dropped (and counted) instead of blocking the filter when more than maxBufferedBytes are pending.
+     
+     File layout (little endian):
+       header: "PTRC", uint32 version, uint32 flags
+       frame:  uint8 kind, zigzag varint timestamp delta [ms], uint32 nStates, nStates * state
+       state:  x, y, z, floor as float16 (HALF_PRECISION_POSITION) or float32,
+               orientation, velocity, normalVelocity, orientationBias, rssiBias, weight,
+               negativeLogLikelihood, mahalanobisDistance as float32
+     **/
+    class ParticleTraceRecorder{
+    public:
+        using Ptr = std::shared_ptr<ParticleTraceRecorder>;
+        
+        enum FrameKind{
+            BEFORE_LIKELIHOOD,
+            AFTER_LIKELIHOOD,
+            RESAMPLED,
+            OTHER
+        };
+        
+        enum Flags{
+            HALF_PRECISION_POSITION = 1
+        };
+        
+        class Parameters{
+        public:
+            bool usesHalfPrecisionPosition = false;
+            size_t maxBufferedBytes = 16*1024*1024;
+            size_t preallocatedBytes = 64*1024*1024; // file size reserved on open and trimmed on close
+        };
+        
+        ParticleTraceRecorder(const std::string& filePath);
+        ParticleTraceRecorder(const std::string& filePath, Parameters params);
+        ~ParticleTraceRecorder();
+        ParticleTraceRecorder(const ParticleTraceRecorder&) = delete;
+        ParticleTraceRecorder& operator=(const ParticleTraceRecorder&) = delete;
+        
+        // Called from the filter thread.
+        void record(const States& states, FrameKind kind, long timestamp);
+        // Blocks until all recorded frames are written to the file.
+        void flush();
+        void close();
+        
+        long nFramesWritten() const;
+        long nFramesDropped() const;
+        
+        static std::string frameKindToString(FrameKind kind);
+        // Converts a trace file to CSV with columns timestamp,kind,index followed by State::header().
+        static void convertToCSV(const std::string& tracePath, const std::string& csvPath);
+        
+    private:
+        using Buffer = std::vector<uint8_t>;
+        
+        Parameters mParams;
+        std::FILE* mFile = NULL;
+        long mBytesWritten = 0;
+        long mPreviousTimestamp = 0;
+        
+        std::mutex mMutex;
+        std::condition_variable mCV;
+        std::condition_variable mFlushedCV;
+        std::deque<Buffer> mPending;
+        std::vector<Buffer> mFreeBuffers;
+        size_t mPendingBytes = 0;
+        bool mWriting = false;
+        bool mRunning = true;
+        std::thread mWriter;
+        
+        std::atomic<long> mFramesWritten{0};
+        std::atomic<long> mFramesDropped{0};
+        
+        void run();
+    };
+    
+}
+
+#endif /* ParticleTraceRecorder_hpp */
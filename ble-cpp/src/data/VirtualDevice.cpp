@@ -135,8 +135,8 @@ namespace loc{
                         sstream << locTrue << "," << *poseEst << std::endl;
                         if(savesStates){
                             std::stringstream ss;
-                            std::shared_ptr<std::vector<State>> states = status->states();
-                            for(State state: *states){
+                            auto states = status->states();
+                            for(const State& state: *states){
                                 ss << state << std::endl;
                             }
                             std::string filepath = mResultDir+"/states_"+std::to_string(beacons.timestamp())+".csv";
@@ -20,6 +20,7 @@
  * THE SOFTWARE.
  *******************************************************************************/
 
+#include <cmath>
 #include "GridResampler.hpp"
 
 namespace loc{
@@ -27,40 +28,87 @@ namespace loc{
     class Location;
     class Pose;
     
+    template<class Tstate> GridResampler<Tstate>& GridResampler<Tstate>::gridType(GridType type){
+        gtype = type;
+        return *this;
+    }
+    
+    template<class Tstate> typename GridResampler<Tstate>::GridType GridResampler<Tstate>::gridType() const{
+        return gtype;
+    }
+    
     template<class Tstate> std::vector<Tstate>* GridResampler<Tstate>::resample(const std::vector<Tstate>& states, const double weights[]){
         
         int n = (int) states.size();
         std::vector<Tstate>* statesResampled = new std::vector<Tstate>();
+        statesResampled->reserve(n);
         
-        double d = rand.nextDouble();
-        std::vector<double> grid(n);
-        
-        for (int k=0; k<n; k++){
-            if(gtype==STRATIFIED){
-                d = rand.nextDouble();
-            }
-            grid[k] = ((double)k + d)/((double)n);
+        mIndices.resize(n);
+        resampleIndices(weights, n, mIndices.data());
+        for(int k=0; k<n; k++){
+            statesResampled->push_back(states.at(mIndices[k]));
+        }
+        return statesResampled;
+    }
+    
+    template<class Tstate> void GridResampler<Tstate>::resampleInPlace(std::vector<Tstate>& states, const double weights[]){
+        int n = (int) states.size();
+        mIndices.resize(n);
+        resampleIndices(weights, n, mIndices.data());
+        this->gather(states, mIndices.data());
+    }
+    
+    template<class Tstate> void GridResampler<Tstate>::resampleIndices(const double weights[], int n, int indices[]){
+        if(n<=0){
+            return;
+        }
+        if(gtype!=RESIDUAL){
+            gridIndices(weights, n, n, indices);
+            return;
         }
         
-        double cumWeight=0;
-        int k=0;
+        // Residual resampling: floor(n*w_i) copies are deterministically assigned and
+        // the remaining samples are drawn from the residual weights.
+        mResiduals.resize(n);
+        int k = 0;
+        double sumResiduals = 0;
         for(int i=0; i<n; i++){
-            int numSample = 0;
-            cumWeight += weights[i];
-            if(i==n-1){
-                cumWeight = 1.0;
+            double nw = n*weights[i];
+            int nCopies = (int) std::floor(nw);
+            for(int c=0; c<nCopies && k<n; c++){
+                indices[k++] = i;
             }
-            for( ; k<n; k++){
-                if(grid[k] < cumWeight){
-                    Tstate stateCopied(states.at(i));
-                    statesResampled->push_back(stateCopied);
-                    numSample++;
-                }else{
-                    break;
+            mResiduals[i] = nw - nCopies;
+            sumResiduals += mResiduals[i];
+        }
+        int nRest = n - k;
+        if(nRest>0){
+            if(sumResiduals<=0){
+                gridIndices(weights, n, nRest, indices+k);
+            }else{
+                for(int i=0; i<n; i++){
+                    mResiduals[i] /= sumResiduals;
                 }
+                gridIndices(mResiduals.data(), n, nRest, indices+k);
             }
         }
-        return statesResampled;
+    }
+    
+    template<class Tstate> void GridResampler<Tstate>::gridIndices(const double weights[], int n, int nSamples, int indices[]){
+        double d = rand.nextDouble();
+        int i = 0;
+        double cumWeight = weights[0];
+        for(int k=0; k<nSamples; k++){
+            if(gtype==STRATIFIED){
+                d = rand.nextDouble();
+            }
+            double grid = ((double)k + d)/((double)nSamples);
+            while(cumWeight <= grid && i<n-1){
+                i++;
+                cumWeight += weights[i];
+            }
+            indices[k] = i;
+        }
     }
     
     // Explicit instantiation
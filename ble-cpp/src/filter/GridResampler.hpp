@@ -33,14 +33,24 @@ namespace loc{
     template<class Tstate> class GridResampler : public Resampler<Tstate>{
     
     public:
+        enum GridType{SYSTEMATIC, STRATIFIED, RESIDUAL};
+        
         ~GridResampler(){}
         
-        std::vector<Tstate>* resample(const std::vector<Tstate>& states, const double weights[]);
+        GridResampler& gridType(GridType);
+        GridType gridType() const;
+        
+        std::vector<Tstate>* resample(const std::vector<Tstate>& states, const double weights[]) override;
+        void resampleIndices(const double weights[], int n, int indices[]) override;
+        void resampleInPlace(std::vector<Tstate>& states, const double weights[]) override;
     
     private:
-        enum GridType{SYSTEMATIC, STRATIFIED};
-        GridType gtype = SYSTEMATIC;        
+        GridType gtype = SYSTEMATIC;
         RandomGenerator rand;
+        std::vector<int> mIndices;
+        std::vector<double> mResiduals;
+        
+        void gridIndices(const double weights[], int n, int nSamples, int indices[]);
     };
 
 }
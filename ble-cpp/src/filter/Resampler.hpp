@@ -24,7 +24,9 @@
 #define Resampler_hpp
 
 #include <stdio.h>
+#include <memory>
 #include "bleloc.h"
+#include "LocException.hpp"
 
 namespace loc{
     
@@ -32,6 +34,42 @@ namespace loc{
     public:
         virtual ~Resampler(){}
         virtual std::vector<Tstate>* resample(const std::vector<Tstate> & states, const double weights[]) = 0;
+        
+        // Writes n ancestor indices selected according to weights into indices.
+        virtual void resampleIndices(const double weights[], int n, int indices[]){
+            BOOST_THROW_EXCEPTION(LocException("resampleIndices is not supported by this resampler."));
+        }
+        
+        // Replaces states with resampled states reusing the storage of states.
+        virtual void resampleInPlace(std::vector<Tstate>& states, const double weights[]){
+            std::unique_ptr<std::vector<Tstate>> statesResampled(resample(states, weights));
+            states.swap(*statesResampled);
+        }
+        
+        // In-place gather of states[indices[k]] (k=0,...,n-1).
+        // Each state that survives keeps its slot and only the slots of discarded states are overwritten by copies.
+        void gather(std::vector<Tstate>& states, const int indices[]){
+            int n = (int) states.size();
+            std::vector<int>& counts = mGatherCounts;
+            counts.assign(n, 0);
+            for(int k=0; k<n; k++){
+                counts[indices[k]]++;
+            }
+            int j = 0; // index of a source state with remaining copies
+            for(int i=0; i<n; i++){
+                if(counts[i]>0){
+                    continue;
+                }
+                while(counts[j]<=1){
+                    j++;
+                }
+                states[i] = states[j];
+                counts[j]--;
+            }
+        }
+        
+    protected:
+        std::vector<int> mGatherCounts; // reused by gather
     };
     
 }
@@ -0,0 +1,105 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#include "DeadlineScheduler.hpp"
+#include <algorithm>
+
+namespace loc{
+    
+    DeadlineScheduler::DeadlineScheduler()
+    : DeadlineScheduler(Parameters())
+    {}
+    
+    DeadlineScheduler::DeadlineScheduler(Parameters params)
+    : mParams(params)
+    {}
+    
+    const DeadlineScheduler::Parameters& DeadlineScheduler::parameters() const{
+        return mParams;
+    }
+    
+    void DeadlineScheduler::reportPredictionLatency(double ms){
+        double a = mParams.smoothingFactor;
+        mPredictionLatency = (1.0-a)*mPredictionLatency + a*ms;
+        updateLevel();
+    }
+    
+    void DeadlineScheduler::reportUpdateLatency(double ms){
+        double a = mParams.smoothingFactor;
+        mUpdateLatency = (1.0-a)*mUpdateLatency + a*ms;
+        updateLevel();
+    }
+    
+    double DeadlineScheduler::load() const{
+        return std::max(mPredictionLatency/mParams.predictionBudgetMS, mUpdateLatency/mParams.updateBudgetMS);
+    }
+    
+    void DeadlineScheduler::updateLevel(){
+        mReportsSinceChange++;
+        // Wait for the effect of the previous change before changing the level again.
+        if(mReportsSinceChange < mParams.minReportsBetweenChanges){
+            return;
+        }
+        double l = load();
+        Level newLevel = mLevel;
+        if(1.0 < l && mLevel < MERGE_PREDICTIONS){
+            newLevel = static_cast<Level>(mLevel + 1);
+        }else if(l < mParams.lowerLoadRatio && NORMAL < mLevel){
+            newLevel = static_cast<Level>(mLevel - 1);
+        }
+        if(newLevel != mLevel){
+            mLevel = newLevel;
+            mReportsSinceChange = 0;
+        }
+    }
+    
+    DeadlineScheduler::Level DeadlineScheduler::level() const{
+        return mLevel;
+    }
+    
+    bool DeadlineScheduler::defersMixing() const{
+        return DEFER_MIXING <= mLevel;
+    }
+    
+    bool DeadlineScheduler::subsamplesLikelihood() const{
+        return SUBSAMPLE_LIKELIHOOD <= mLevel;
+    }
+    
+    bool DeadlineScheduler::mergesPredictions() const{
+        return MERGE_PREDICTIONS <= mLevel;
+    }
+    
+    std::string DeadlineScheduler::levelToString(Level level){
+        switch(level){
+            case NORMAL:
+                return "NORMAL";
+            case DEFER_MIXING:
+                return "DEFER_MIXING";
+            case SUBSAMPLE_LIKELIHOOD:
+                return "SUBSAMPLE_LIKELIHOOD";
+            case MERGE_PREDICTIONS:
+                return "MERGE_PREDICTIONS";
+        }
+        return "";
+    }
+    
+}
@@ -0,0 +1,95 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef DeadlineScheduler_hpp
+#define DeadlineScheduler_hpp
+
+#include <stdio.h>
+#include <memory>
+#include <string>
+
+namespace loc{
+    
+    /**
+     Tracks the processing time of predictions and observation updates against a latency budget and
+     selects a degradation level. Levels are cumulative:
+       DEFER_MIXING: mixing with observation-dependent states is deferred (at most maxMixingDeferralMS)
+       SUBSAMPLE_LIKELIHOOD: the likelihood is evaluated on a weighted subsample of the states
+       MERGE_PREDICTIONS: consecutive motion predictions are merged
+     The level is raised when the smoothed load exceeds the budget and lowered when it falls below lowerLoadRatio.
+     **/
+    class DeadlineScheduler{
+    public:
+        using Ptr = std::shared_ptr<DeadlineScheduler>;
+        
+        enum Level{
+            NORMAL = 0,
+            DEFER_MIXING,
+            SUBSAMPLE_LIKELIHOOD,
+            MERGE_PREDICTIONS
+        };
+        
+        class Parameters{
+        public:
+            double predictionBudgetMS = 10;
+            double updateBudgetMS = 100;
+            double smoothingFactor = 0.2;   // weight of the latest latency in the moving average
+            double lowerLoadRatio = 0.5;
+            int minReportsBetweenChanges = 5;
+            long maxMixingDeferralMS = 10000;
+            double subsampleRate = 0.5;
+            int minSubsampleStates = 100;
+            long maxMergedIntervalMS = 500;
+        };
+        
+        DeadlineScheduler();
+        DeadlineScheduler(Parameters params);
+        ~DeadlineScheduler() = default;
+        
+        const Parameters& parameters() const;
+        
+        void reportPredictionLatency(double ms);
+        void reportUpdateLatency(double ms);
+        
+        Level level() const;
+        // smoothed latency divided by its budget (the larger of prediction and update)
+        double load() const;
+        
+        bool defersMixing() const;
+        bool subsamplesLikelihood() const;
+        bool mergesPredictions() const;
+        
+        static std::string levelToString(Level level);
+        
+    private:
+        Parameters mParams;
+        Level mLevel = NORMAL;
+        double mPredictionLatency = 0;
+        double mUpdateLatency = 0;
+        int mReportsSinceChange = 0;
+        
+        void updateLevel();
+    };
+    
+}
+
+#endif /* DeadlineScheduler_hpp */
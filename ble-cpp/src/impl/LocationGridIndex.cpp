@@ -0,0 +1,111 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#include "LocationGridIndex.hpp"
+#include "LocException.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace loc{
+    
+    LocationGridIndex::LocationGridIndex(const std::vector<Location>& locations, double cellSize)
+    : mCellSize(cellSize), mLocations(locations)
+    {
+        if(!(0 < cellSize)){
+            BOOST_THROW_EXCEPTION(LocException("cellSize must be positive."));
+        }
+        std::map<double, std::vector<uint32_t>> floorIndices;
+        for(size_t i=0; i<mLocations.size(); i++){
+            floorIndices[mLocations[i].floor()].push_back(static_cast<uint32_t>(i));
+        }
+        for(const auto& pair: floorIndices){
+            const auto& indices = pair.second;
+            FloorGrid& grid = mFloors[pair.first];
+            double xMax = -std::numeric_limits<double>::max();
+            double yMax = -std::numeric_limits<double>::max();
+            grid.xMin = std::numeric_limits<double>::max();
+            grid.yMin = std::numeric_limits<double>::max();
+            for(uint32_t i: indices){
+                grid.xMin = std::min(grid.xMin, mLocations[i].x());
+                grid.yMin = std::min(grid.yMin, mLocations[i].y());
+                xMax = std::max(xMax, mLocations[i].x());
+                yMax = std::max(yMax, mLocations[i].y());
+            }
+            grid.nx = static_cast<int>((xMax - grid.xMin)/cellSize) + 1;
+            grid.ny = static_cast<int>((yMax - grid.yMin)/cellSize) + 1;
+            
+            auto cellOf = [&](uint32_t i){
+                int cx = std::min(grid.nx-1, static_cast<int>((mLocations[i].x() - grid.xMin)/cellSize));
+                int cy = std::min(grid.ny-1, static_cast<int>((mLocations[i].y() - grid.yMin)/cellSize));
+                return static_cast<size_t>(cy)*grid.nx + cx;
+            };
+            grid.cellStart.assign(static_cast<size_t>(grid.nx)*grid.ny + 1, 0);
+            for(uint32_t i: indices){
+                grid.cellStart[cellOf(i)+1]++;
+            }
+            for(size_t c=1; c<grid.cellStart.size(); c++){
+                grid.cellStart[c] += grid.cellStart[c-1];
+            }
+            grid.items.resize(indices.size());
+            std::vector<uint32_t> fill(grid.cellStart.begin(), grid.cellStart.end()-1);
+            for(uint32_t i: indices){
+                grid.items[fill[cellOf(i)]++] = i;
+            }
+        }
+    }
+    
+    size_t LocationGridIndex::size() const{
+        return mLocations.size();
+    }
+    
+    void LocationGridIndex::findWithinRadius(const Location& center, double radius2D, std::vector<size_t>& indices) const{
+        auto iter = mFloors.find(center.floor());
+        if(iter==mFloors.end() || radius2D < 0){
+            return;
+        }
+        const FloorGrid& grid = iter->second;
+        int cx0 = static_cast<int>(std::floor((center.x() - radius2D - grid.xMin)/mCellSize));
+        int cx1 = static_cast<int>(std::floor((center.x() + radius2D - grid.xMin)/mCellSize));
+        int cy0 = static_cast<int>(std::floor((center.y() - radius2D - grid.yMin)/mCellSize));
+        int cy1 = static_cast<int>(std::floor((center.y() + radius2D - grid.yMin)/mCellSize));
+        cx0 = std::max(cx0, 0);
+        cy0 = std::max(cy0, 0);
+        cx1 = std::min(cx1, grid.nx-1);
+        cy1 = std::min(cy1, grid.ny-1);
+        
+        size_t nBefore = indices.size();
+        for(int cy=cy0; cy<=cy1; cy++){
+            for(int cx=cx0; cx<=cx1; cx++){
+                size_t c = static_cast<size_t>(cy)*grid.nx + cx;
+                for(uint32_t k=grid.cellStart[c]; k<grid.cellStart[c+1]; k++){
+                    uint32_t i = grid.items[k];
+                    if(Location::distance2D(mLocations[i], center) <= radius2D){
+                        indices.push_back(i);
+                    }
+                }
+            }
+        }
+        std::sort(indices.begin()+nBefore, indices.end());
+    }
+    
+}
@@ -0,0 +1,67 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef LocationGridIndex_hpp
+#define LocationGridIndex_hpp
+
+#include <stdio.h>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "Location.hpp"
+
+namespace loc{
+    
+    /**
+     Uniform grid of locations per floor for radius queries in 2D.
+     **/
+    class LocationGridIndex{
+    public:
+        using Ptr = std::shared_ptr<LocationGridIndex>;
+        
+        LocationGridIndex(const std::vector<Location>& locations, double cellSize);
+        ~LocationGridIndex() = default;
+        
+        size_t size() const;
+        // Appends the indices of the locations on the same floor as center with Location::distance2D <= radius2D.
+        // Indices are appended in ascending order.
+        void findWithinRadius(const Location& center, double radius2D, std::vector<size_t>& indices) const;
+        
+    private:
+        struct FloorGrid{
+            double xMin;
+            double yMin;
+            int nx;
+            int ny;
+            std::vector<uint32_t> cellStart; // nx*ny+1
+            std::vector<uint32_t> items; // indices of locations sorted by cell
+        };
+        
+        double mCellSize;
+        std::vector<Location> mLocations;
+        std::map<double, FloorGrid> mFloors;
+    };
+    
+}
+
+#endif /* LocationGridIndex_hpp */
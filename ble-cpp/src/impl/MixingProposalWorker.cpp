@@ -0,0 +1,123 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#include "MixingProposalWorker.hpp"
+
+namespace loc{
+    
+    MixingProposalWorker::MixingProposalWorker(Generator generator) : mGenerator(generator){
+        mThread = std::thread(&MixingProposalWorker::run, this);
+    }
+    
+    MixingProposalWorker::~MixingProposalWorker(){
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mRunning = false;
+        }
+        mCV.notify_all();
+        if(mThread.joinable()){
+            mThread.join();
+        }
+    }
+    
+    void MixingProposalWorker::request(const Beacons& beacons, int nStates){
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mRequestedBeacons = beacons;
+            mRequestedNStates = nStates;
+            mHasRequest = true;
+        }
+        mCV.notify_one();
+    }
+    
+    bool MixingProposalWorker::take(long timestamp, long maxAgeMS, Proposal& proposal){
+        std::unique_lock<std::mutex> lock(mMutex);
+        if(mError){
+            std::exception_ptr error;
+            std::swap(error, mError);
+            lock.unlock();
+            std::rethrow_exception(error);
+        }
+        if(!mHasProposal){
+            return false;
+        }
+        long age = timestamp - mProposal.timestamp;
+        if(age < 0 || maxAgeMS < age){
+            mHasProposal = false;
+            mDropped++;
+            return false;
+        }
+        proposal = std::move(mProposal);
+        mProposal = Proposal();
+        mHasProposal = false;
+        mConsumed++;
+        return true;
+    }
+    
+    long MixingProposalWorker::nGenerated() const{
+        return mGenerated;
+    }
+    
+    long MixingProposalWorker::nConsumed() const{
+        return mConsumed;
+    }
+    
+    long MixingProposalWorker::nDropped() const{
+        return mDropped;
+    }
+    
+    void MixingProposalWorker::run(){
+        while(true){
+            Beacons beacons;
+            int nStates = 0;
+            {
+                std::unique_lock<std::mutex> lock(mMutex);
+                mCV.wait(lock, [this]{return mHasRequest || !mRunning;});
+                if(!mRunning){
+                    return;
+                }
+                beacons = std::move(mRequestedBeacons);
+                nStates = mRequestedNStates;
+                mHasRequest = false;
+            }
+            Proposal proposal;
+            proposal.timestamp = beacons.timestamp();
+            try{
+                mGenerator(beacons, nStates, proposal);
+            }catch(...){
+                std::lock_guard<std::mutex> lock(mMutex);
+                mError = std::current_exception();
+                continue;
+            }
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                if(mHasProposal){
+                    mDropped++;
+                }
+                mProposal = std::move(proposal);
+                mHasProposal = true;
+            }
+            mGenerated++;
+        }
+    }
+    
+}
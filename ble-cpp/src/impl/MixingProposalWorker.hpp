@@ -0,0 +1,96 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef MixingProposalWorker_hpp
+#define MixingProposalWorker_hpp
+
+#include <stdio.h>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "State.hpp"
+#include "Beacon.hpp"
+
+namespace loc{
+    
+    /**
+     Generates states for mixing on a background thread from the most recent beacon frame.
+     Only the latest request is kept; a request arriving while a proposal is generated replaces the pending one.
+     An exception thrown by the generator is rethrown to the consumer by the next take().
+     **/
+    class MixingProposalWorker{
+    public:
+        using Ptr = std::shared_ptr<MixingProposalWorker>;
+        
+        class Proposal{
+        public:
+            long timestamp = 0; // timestamp of the beacons the proposal was generated from
+            States states;
+            std::vector<State> allStates;
+            std::vector<double> allLogLLs;
+        };
+        
+        using Generator = std::function<void(const Beacons& beacons, int nStates, Proposal& proposal)>;
+        
+        MixingProposalWorker(Generator generator);
+        ~MixingProposalWorker();
+        MixingProposalWorker(const MixingProposalWorker&) = delete;
+        MixingProposalWorker& operator=(const MixingProposalWorker&) = delete;
+        
+        void request(const Beacons& beacons, int nStates);
+        // Moves the latest proposal to the argument if it was generated within maxAgeMS before timestamp.
+        // A stale proposal is dropped. Rethrows the exception of a failed generation.
+        bool take(long timestamp, long maxAgeMS, Proposal& proposal);
+        
+        long nGenerated() const;
+        long nConsumed() const;
+        long nDropped() const;
+        
+    private:
+        Generator mGenerator;
+        
+        std::mutex mMutex;
+        std::condition_variable mCV;
+        Beacons mRequestedBeacons;
+        int mRequestedNStates = 0;
+        bool mHasRequest = false;
+        Proposal mProposal;
+        bool mHasProposal = false;
+        std::exception_ptr mError;
+        bool mRunning = true;
+        std::thread mThread;
+        
+        std::atomic<long> mGenerated{0};
+        std::atomic<long> mConsumed{0};
+        std::atomic<long> mDropped{0};
+        
+        void run();
+    };
+    
+}
+
+#endif /* MixingProposalWorker_hpp */
@@ -0,0 +1,82 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#include "StationaryDetector.hpp"
+#include <cmath>
+
+namespace loc{
+    
+    StationaryDetector::StationaryDetector()
+    : StationaryDetector(Parameters())
+    {}
+    
+    StationaryDetector::StationaryDetector(Parameters params)
+    : mParams(params)
+    {}
+    
+    const StationaryDetector::Parameters& StationaryDetector::parameters() const{
+        return mParams;
+    }
+    
+    void StationaryDetector::putSteps(long timestamp, double nSteps){
+        if(0 < nSteps){
+            mIsStill = false;
+        }else if(!mIsStill){
+            mIsStill = true;
+            mStillSince = timestamp;
+        }
+    }
+    
+    bool StationaryDetector::putBeacons(const Beacons& beacons){
+        std::map<long, double> frame;
+        for(const auto& b: beacons){
+            frame[b.id()] = b.rssi();
+        }
+        size_t nShared = 0;
+        double sumDiff = 0;
+        for(const auto& pair: frame){
+            auto iter = mPreviousFrame.find(pair.first);
+            if(iter != mPreviousFrame.end()){
+                nShared++;
+                sumDiff += std::abs(pair.second - iter->second);
+            }
+        }
+        size_t nUnion = frame.size() + mPreviousFrame.size() - nShared;
+        mFramesAreSimilar = 0 < nShared
+                            && mParams.minBeaconOverlapRatio <= static_cast<double>(nShared)/nUnion
+                            && sumDiff/nShared <= mParams.maxMeanRssiDifference;
+        mPreviousFrame.swap(frame);
+        return mFramesAreSimilar;
+    }
+    
+    bool StationaryDetector::isStationary(long timestamp) const{
+        return mIsStill && mParams.minStillDurationMS <= timestamp - mStillSince && mFramesAreSimilar;
+    }
+    
+    void StationaryDetector::reset(){
+        mIsStill = false;
+        mStillSince = 0;
+        mFramesAreSimilar = false;
+        mPreviousFrame.clear();
+    }
+    
+}
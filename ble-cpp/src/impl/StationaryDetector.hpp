@@ -0,0 +1,75 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef StationaryDetector_hpp
+#define StationaryDetector_hpp
+
+#include <stdio.h>
+#include <memory>
+#include <map>
+
+#include "Beacon.hpp"
+
+namespace loc{
+    
+    /**
+     Detects a stationary device from the pedometer output and the similarity of consecutive beacon frames.
+     The device is stationary when no steps have been detected for minStillDurationMS and the latest beacon frame
+     is indistinguishable from the previous one: most beacons are shared (overlap ratio) and the mean absolute
+     RSSI difference of the shared beacons is small.
+     A step ends the stationary state immediately.
+     **/
+    class StationaryDetector{
+    public:
+        using Ptr = std::shared_ptr<StationaryDetector>;
+        
+        class Parameters{
+        public:
+            long minStillDurationMS = 3000;
+            double minBeaconOverlapRatio = 0.8; // |intersection| / |union| of beacon ids
+            double maxMeanRssiDifference = 3.0; // [dB]
+            long likelihoodRefreshIntervalMS = 10000; // cached likelihoods are recomputed at least at this interval
+        };
+        
+        StationaryDetector();
+        StationaryDetector(Parameters params);
+        ~StationaryDetector() = default;
+        
+        const Parameters& parameters() const;
+        
+        void putSteps(long timestamp, double nSteps);
+        // Returns true when the frame is indistinguishable from the previous frame.
+        bool putBeacons(const Beacons& beacons);
+        bool isStationary(long timestamp) const;
+        void reset();
+        
+    private:
+        Parameters mParams;
+        long mStillSince = 0;
+        bool mIsStill = false;
+        bool mFramesAreSimilar = false;
+        std::map<long, double> mPreviousFrame;
+    };
+    
+}
+
+#endif /* StationaryDetector_hpp */
@@ -21,11 +21,14 @@
  *******************************************************************************/
 
 #include "StatusInitializerImpl.hpp"
+#include <algorithm>
 
 namespace loc{
     
     StatusInitializerImpl& StatusInitializerImpl::dataStore(std::shared_ptr<DataStore> dataStore){
         mDataStore = dataStore;
+        std::lock_guard<std::mutex> lock(mCandidateIndexMutex);
+        mCandidateIndex.reset();
         return *this;
     }
     
@@ -38,6 +41,11 @@ namespace loc{
         mStateProperty = stateProperty;
         return *this;
     }
+    
+    StatusInitializerImpl& StatusInitializerImpl::movableLocationSampler(MovableLocationSampler::Ptr sampler){
+        mMovableLocationSampler = sampler;
+        return *this;
+    }
 
     
     State StatusInitializerImpl::perturbRssiBias(const State &state){
@@ -68,6 +76,16 @@ namespace loc{
     template <class Tstate>
     Tstate StatusInitializerImpl::perturbLocation(const Tstate& location, double stdx, double stdy, const Building& building){
         bool hasBuilding = building.nFloors()>0? true: false;
+        if(hasBuilding && mMovableLocationSampler && mMovableLocationSampler->hasFloor(static_cast<int>(location.floor()))){
+            Location locSampled;
+            if(mMovableLocationSampler->sampleGaussian(location, stdx, stdy, rand, locSampled)){
+                Tstate locNew(location);
+                locNew.x(locSampled.x());
+                locNew.y(locSampled.y());
+                return locNew;
+            }
+            return location;
+        }
         for(int i=0; i<nPerturbationMax; i++){
             Tstate locNew(location);
             double x = locNew.x() + stdx * rand.nextGaussian();
@@ -253,6 +271,8 @@ namespace loc{
         
         States statesTmp = resetStates(n, meanPose, orientationMeasured);
         States states(n);
+        // Every state shares the mean, so the Gaussian of each floor is prepared once and drawn n times.
+        std::map<int, MovableLocationSampler::Gaussian> gaussians;
         for(int i=0; i<n; ){
             while(true){
                 State s = statesTmp.at(i);
@@ -270,6 +290,23 @@ namespace loc{
                 s.x(x).y(y).z(z).floor(floor).orientation(orientation);
                 s.orientationBias(orientationBias);
                 
+                bool isSampled = false;
+                if(building.nFloors()>0 && mMovableLocationSampler && mMovableLocationSampler->hasFloor(static_cast<int>(floor))){
+                    int floorInt = static_cast<int>(floor);
+                    auto iter = gaussians.find(floorInt);
+                    if(iter==gaussians.end()){
+                        Location mean(statesTmp.at(i).x(), statesTmp.at(i).y(), 0, floorInt);
+                        iter = gaussians.emplace(floorInt, MovableLocationSampler::Gaussian()).first;
+                        mMovableLocationSampler->prepareGaussian(mean, stdevState.x(), stdevState.y(), iter->second);
+                    }
+                    Location locSampled;
+                    if(!mMovableLocationSampler->sampleGaussian(iter->second, rand, locSampled)){
+                        continue;
+                    }
+                    s.x(locSampled.x()).y(locSampled.y());
+                    isSampled = true;
+                }
+                
                 // only if meanPose.normalVelocity is valid, normalVelocity is updated.
                 if(mPoseProperty->minVelocity() < meanPose.normalVelocity()
                    && meanPose.normalVelocity() < mPoseProperty->maxVelocity()){
@@ -277,7 +314,11 @@ namespace loc{
                     s.normalVelocity(normalVelocity);
                 }
                 
-                if(building.nFloors()>0){
+                if(isSampled){
+                    states[i] = s;
+                    i++;
+                    break;
+                }else if(building.nFloors()>0){
                     if(building.isMovable(s)){
                         states[i] = s;
                         i++;
@@ -307,33 +348,50 @@ namespace loc{
     }
     
     
+    std::shared_ptr<const StatusInitializerImpl::CandidateIndex> StatusInitializerImpl::candidateIndex() const{
+        auto& uniqueLocations = mDataStore->getLocations();
+        auto& bleBeacons = mDataStore->getBLEBeacons();
+        
+        // The generation is read after the getters because they may fill the contents lazily.
+        unsigned long generation = mDataStore->generation();
+        
+        std::lock_guard<std::mutex> lock(mCandidateIndexMutex);
+        if(mCandidateIndex && mCandidateIndex->dataStore == mDataStore.get() && mCandidateIndex->generation == generation){
+            return mCandidateIndex;
+        }
+        std::shared_ptr<CandidateIndex> index(new CandidateIndex);
+        index->dataStore = mDataStore.get();
+        index->generation = generation;
+        index->grid.reset(new LocationGridIndex(uniqueLocations, mRadius2D > 0 ? mRadius2D : 1.0));
+        index->idToIndexMap = BLEBeacon::constructBeaconIdToIndexMap(bleBeacons);
+        mCandidateIndex = index;
+        return mCandidateIndex;
+    }
+    
     Locations StatusInitializerImpl::extractLocationsCloseToBeacons(const std::vector<Beacon> &beacons, double radius2D) const{
         
         auto& uniqueLocations = mDataStore->getLocations();
         auto& bleBeacons = mDataStore->getBLEBeacons();
         
-        std::map<long, int> idToIndexMap = BLEBeacon::constructBeaconIdToIndexMap(bleBeacons);
-        std::vector<Location> selectedLocations;
+        auto index = candidateIndex();
+        const auto& idToIndexMap = index->idToIndexMap;
         
-        std::vector<BLEBeacon> observedBLEBeacons;
+        // A location is selected once per observed beacon within radius2D, in the order of the locations.
+        std::vector<size_t> indices;
         for(auto& b: beacons){
-            long id = b.id();
-            if(idToIndexMap.count(id)>0){
-                observedBLEBeacons.push_back(bleBeacons.at(idToIndexMap.at(id)));
+            auto iter = idToIndexMap.find(b.id());
+            if(iter!=idToIndexMap.end()){
+                const BLEBeacon& bloc = bleBeacons.at(iter->second);
+                index->grid->findWithinRadius(bloc, radius2D, indices);
             }
         }
+        std::sort(indices.begin(), indices.end());
         
-        for(auto& loc: uniqueLocations){
-            for(auto& bloc: observedBLEBeacons){
-                double dist = Location::distance2D(loc, bloc);
-                double floorDiff = Location::floorDifference(loc, bloc);
-                if(dist <= radius2D && floorDiff==0){
-                    selectedLocations.push_back(loc);
-                    continue;
-                }
-            }
+        std::vector<Location> selectedLocations;
+        selectedLocations.reserve(indices.size());
+        for(size_t i: indices){
+            selectedLocations.push_back(uniqueLocations.at(i));
         }
-        
         return selectedLocations;
     }
     
@@ -342,7 +400,8 @@ namespace loc{
         
         auto& bleBeacons = mDataStore->getBLEBeacons();
         
-        std::map<long, int> idToIndexMap = BLEBeacon::constructBeaconIdToIndexMap(bleBeacons);
+        auto index = candidateIndex();
+        const std::map<long, int>& idToIndexMap = index->idToIndexMap;
         std::vector<Location> selectedLocations;
 
         std::vector<BLEBeacon> observedBLEBeacons;
@@ -25,11 +25,15 @@
 
 #include <stdio.h>
 #include <cmath>
+#include <map>
 #include <memory>
+#include <mutex>
 
 #include "RandomGenerator.hpp"
 #include "StatusInitializer.hpp"
 #include "DataStore.hpp"
+#include "MovableLocationSampler.hpp"
+#include "LocationGridIndex.hpp"
 
 namespace loc{
     /**
@@ -41,6 +45,18 @@ namespace loc{
     private:
         RandomGenerator rand;
         std::shared_ptr<DataStore> mDataStore;
+        MovableLocationSampler::Ptr mMovableLocationSampler;
+        
+        // Spatial index of the sampling locations and beacon id index, rebuilt when the data store contents change.
+        struct CandidateIndex{
+            const DataStore* dataStore;
+            unsigned long generation;
+            std::shared_ptr<LocationGridIndex> grid;
+            std::map<long, int> idToIndexMap;
+        };
+        mutable std::mutex mCandidateIndexMutex;
+        mutable std::shared_ptr<const CandidateIndex> mCandidateIndex;
+        std::shared_ptr<const CandidateIndex> candidateIndex() const;
         
         template<class Tstate>
         Tstate perturbLocation(const Tstate& location, const Building& building);
@@ -60,6 +76,8 @@ namespace loc{
         StatusInitializerImpl& dataStore(std::shared_ptr<DataStore> dataStore);
         StatusInitializerImpl& poseProperty(PoseProperty::Ptr poseProperty);
         StatusInitializerImpl& stateProperty(StateProperty::Ptr stateProperty);
+        // Perturbed locations are drawn from movable locations directly instead of retrying up to nPerturbationMax times when set.
+        StatusInitializerImpl& movableLocationSampler(MovableLocationSampler::Ptr sampler);
         
         template<class Tstate>
         Tstate perturbLocation(const Tstate& location);
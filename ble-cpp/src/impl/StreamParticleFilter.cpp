@@ -21,8 +21,11 @@
  *******************************************************************************/
 
 #include <thread>
+#include <mutex>
+#include <chrono>
 #include <queue>
 #include <functional>
+#include <unordered_map>
 
 #include "StreamParticleFilter.hpp"
 #include "StreamLocalizer.hpp"
@@ -37,8 +40,11 @@
 #include "PoseRandomWalker.hpp"
 
 #include "ArrayUtils.hpp"
+#include "MonotonicArena.hpp"
 #include "DataStore.hpp"
 #include "DataLogger.hpp"
+#include "ParticleTraceRecorder.hpp"
+#include "MixingProposalWorker.hpp"
 #include "BaseBeaconFilter.hpp"
 #include "CleansingBeaconFilter.hpp"
 
@@ -249,6 +255,170 @@ namespace loc{
         }
     };
     
+    // Summary of a particle cloud that answers the rate of states on a different floor exactly in O(log N)
+    // and compares the mean distance to a location with a threshold by using per-cell centroids.
+    class StatesDistanceSummary{
+        struct Cell{
+            int count = 0;
+            double x = 0;
+            double y = 0;
+            double z = 0;
+        };
+        
+        std::vector<double> mFloors; // sorted
+        std::vector<Cell> mCells;
+        std::unordered_map<long long, int> mKeyToCell;
+        double mCellSize;
+        long long mIzMin = 0;
+        long long mIzMax = -1;
+        double mX = 0, mY = 0, mZ = 0; // sums of the coordinates of the states
+        double mSumDeviation = 0; // sum of the distances between states and the centroids of their cells
+        double mSumCellDeviation = 0; // sum of count * distance between the cell centroids and the centroid of the states
+        
+        long long cellIndex(double v) const{
+            return static_cast<long long>(std::floor(v/mCellSize));
+        }
+        
+        static long long cellKey(long long ix, long long iy, long long iz){
+            return ((ix & 0x1FFFFF) << 42) | ((iy & 0x1FFFFF) << 21) | (iz & 0x1FFFFF);
+        }
+        
+        static double distance(double x, double y, double z, const Location& loc){
+            double dx = x - loc.x();
+            double dy = y - loc.y();
+            double dz = z - loc.z();
+            return std::sqrt(dx*dx + dy*dy + dz*dz);
+        }
+        
+    public:
+        StatesDistanceSummary(const States& states, double cellSize) : mCellSize(cellSize){
+            size_t n = states.size();
+            mFloors.resize(n);
+            std::vector<int> cellIndices(n);
+            for(size_t i=0; i<n; i++){
+                const auto& s = states[i];
+                mFloors[i] = s.floor();
+                long long iz = cellIndex(s.z());
+                long long key = cellKey(cellIndex(s.x()), cellIndex(s.y()), iz);
+                auto iter = mKeyToCell.find(key);
+                int c;
+                if(iter==mKeyToCell.end()){
+                    c = static_cast<int>(mCells.size());
+                    mKeyToCell[key] = c;
+                    mCells.push_back(Cell());
+                }else{
+                    c = iter->second;
+                }
+                Cell& cell = mCells[c];
+                cell.count++;
+                cell.x += s.x();
+                cell.y += s.y();
+                cell.z += s.z();
+                cellIndices[i] = c;
+                mX += s.x();
+                mY += s.y();
+                mZ += s.z();
+                mIzMin = i==0 ? iz : std::min(mIzMin, iz);
+                mIzMax = i==0 ? iz : std::max(mIzMax, iz);
+            }
+            std::sort(mFloors.begin(), mFloors.end());
+            for(auto& cell: mCells){
+                cell.x /= cell.count;
+                cell.y /= cell.count;
+                cell.z /= cell.count;
+            }
+            for(size_t i=0; i<n; i++){
+                const auto& s = states[i];
+                const Cell& cell = mCells[cellIndices[i]];
+                mSumDeviation += distance(cell.x, cell.y, cell.z, s);
+            }
+            if(0<n){
+                Location centroid(mX/n, mY/n, mZ/n, 0);
+                for(const auto& cell: mCells){
+                    mSumCellDeviation += cell.count*distance(cell.x, cell.y, cell.z, centroid);
+                }
+            }
+        }
+        
+        // Rate of states with floorDifference > 0.5
+        double rateFloorDifferent(const Location& loc) const{
+            size_t n = mFloors.size();
+            auto lower = std::lower_bound(mFloors.begin(), mFloors.end(), loc.floor() - 0.5);
+            auto upper = std::upper_bound(mFloors.begin(), mFloors.end(), loc.floor() + 0.5);
+            size_t nSame = std::distance(lower, upper);
+            return static_cast<double>(n - nSame)/n;
+        }
+        
+        // Whether the mean distance between the states and loc is larger than threshold.
+        // Only the cells within the threshold of loc are visited; the other cells are bounded from their aggregates
+        // (Jensen's inequality from below and the triangle inequality through the centroid of the states from above).
+        // All cells are visited only when these bounds are not decisive, and the mean distance from the cell centroids,
+        // which differs from the exact one by at most the mean deviation in cells, decides when even they are not.
+        bool isMeanDistanceLarger(const Location& loc, double threshold) const{
+            size_t n = mFloors.size();
+            if(n==0){
+                return false;
+            }
+            double deviation = mSumDeviation/n;
+            
+            double nearSum = 0, nearCellDeviation = 0;
+            double nearX = 0, nearY = 0, nearZ = 0;
+            long nNear = 0;
+            Location centroid(mX/n, mY/n, mZ/n, 0);
+            auto visit = [&](const Cell& cell){
+                nearSum += cell.count*distance(cell.x, cell.y, cell.z, loc);
+                nearCellDeviation += cell.count*distance(cell.x, cell.y, cell.z, centroid);
+                nearX += cell.count*cell.x;
+                nearY += cell.count*cell.y;
+                nearZ += cell.count*cell.z;
+                nNear += cell.count;
+            };
+            long long r = static_cast<long long>(std::ceil(threshold/mCellSize));
+            long long ix = cellIndex(loc.x()), iy = cellIndex(loc.y()), iz = cellIndex(loc.z());
+            long long izMin = std::max(iz - r, mIzMin), izMax = std::min(iz + r, mIzMax);
+            double nLookups = (2.0*r + 1)*(2.0*r + 1)*std::max(izMax - izMin + 1, 0LL);
+            if(static_cast<double>(mCells.size()) <= nLookups){
+                for(const auto& cell: mCells){
+                    visit(cell);
+                }
+            }else{
+                for(long long z=izMin; z<=izMax; z++){
+                    for(long long y=iy-r; y<=iy+r; y++){
+                        for(long long x=ix-r; x<=ix+r; x++){
+                            auto iter = mKeyToCell.find(cellKey(x, y, z));
+                            if(iter!=mKeyToCell.end()){
+                                visit(mCells[iter->second]);
+                            }
+                        }
+                    }
+                }
+            }
+            
+            double lowerSum = nearSum, upperSum = nearSum;
+            long nFar = static_cast<long>(n) - nNear;
+            if(0<nFar){
+                lowerSum += nFar*distance((mX - nearX)/nFar, (mY - nearY)/nFar, (mZ - nearZ)/nFar, loc);
+                upperSum += (mSumCellDeviation - nearCellDeviation) + nFar*Location::distance(centroid, loc);
+            }
+            if(threshold < lowerSum/n){
+                return true;
+            }
+            if(upperSum/n + deviation <= threshold){
+                return false;
+            }
+            
+            double meanDist = nearSum/n;
+            if(0<nFar){
+                double sumDist = 0;
+                for(const auto& cell: mCells){
+                    sumDist += cell.count*distance(cell.x, cell.y, cell.z, loc);
+                }
+                meanDist = sumDist/n;
+            }
+            return threshold < meanDist;
+        }
+    };
+    
 
     class StreamParticleFilter::Impl{
 
@@ -260,6 +430,48 @@ namespace loc{
         long previousTimestampMotion = 0;
         long timestampIntervalLimit = 2000; // 2.0[s]
         
+        // merging of motion predictions (batch input)
+        bool mMergesMotionPredictions = false;
+        long mMaxMergedIntervalMS = 1000;
+        long mDeferredMotionTimestamp = 0;
+        // prediction cadence of streaming input (0: prediction at every motion update)
+        long mPredictionIntervalMS = 0;
+        // motion sensor values aggregated between merged predictions
+        long mAggregatedUntil = 0;
+        double mAggregatedDuration = 0;
+        double mAggregatedWalkingDuration = 0;
+        double mAggregatedNSteps = 0;
+        double mAggregatedYawCos = 0;
+        double mAggregatedYawSin = 0;
+        double mAggregatedWalkingYawCos = 0;
+        double mAggregatedWalkingYawSin = 0;
+        int mAggregatedIntervals = 0;
+        double mAggregatedYawChangeSq = 0;
+        double mAggregatedAngularVelocitySq = 0;
+        // yaw at the latest motion update
+        long mLastMotionYawTimestamp = 0;
+        double mLastMotionYaw = 0;
+        // deferral of update callbacks (batch input)
+        bool mDefersCallback = false;
+        bool mHasDeferredCallback = false;
+        
+        DeadlineScheduler::Ptr mScheduler;
+        
+        // stationary fast path
+        StationaryDetector::Ptr mStationaryDetector;
+        std::weak_ptr<const States> mLikelihoodCacheStates; // states whose negativeLogLikelihood is valid for the latest beacons
+        long mLikelihoodCachedAt = 0;
+        
+        // background generation of states for mixing
+        MixingProposalWorker::Ptr mMixWorker;
+        long mMaxProposalAgeMS = 1500;
+        // Guards mMetro, mStatusInitializer and mMixParams shared with mMixWorker.
+        // The worker also reaches the observation model (through mMetro) and the Building concurrently with the
+        // filter thread. Their likelihood and map queries only read immutable data; the observation model allocates
+        // from the arena only on the thread that opened its scope, and the lazily built map indices are locked inside
+        // ImageHolder and TiledLabelStore.
+        std::mutex mGenerationMutex;
+        
         double mEssThreshold = 10000; //effective sampling size (typically nNumStates/2. nNumState<=essThreshold for frequent resampling.)
         Location mLocStdevLB;
         
@@ -291,6 +503,11 @@ namespace loc{
         std::shared_ptr<PosteriorResampler<State>> mPostResampler;
         std::shared_ptr<RandomGenerator> mRand;
         
+        std::vector<double> mWeights; // reused buffer for weight update
+        double mixDensityCellSize = 1.0; // [m] cell size of StatesDistanceSummary
+        MonotonicArena::Ptr mArena = std::make_shared<MonotonicArena>(); // transient data of a put* call
+        ParticleTraceRecorder::Ptr mTraceRecorder;
+        
         DataStore::Ptr mDataStore;
         
         std::shared_ptr<FloorUpdater> mFloorUpdater;
@@ -314,7 +531,9 @@ namespace loc{
                 mRand(new RandomGenerator())
         { }
 
-        ~Impl(){}
+        ~Impl(){
+            mMixWorker.reset();
+        }
 
         void initializeStatusIfZero(){
             if(status->states()->size()==0) {
@@ -323,20 +542,33 @@ namespace loc{
         }
 
         void putAcceleration(const Acceleration acceleration){
+            MonotonicArena::Scope arenaScope(*mArena);
             initializeStatusIfZero();
             status->step(Status::OTHER);
             
             mPedometer->putAcceleration(acceleration);
             accelerationIsUpdated = mPedometer->isUpdated();
+            if(mStationaryDetector){
+                mStationaryDetector->putSteps(acceleration.timestamp(), mPedometer->getNSteps());
+            }
 
             // TODO (Tentative implementation)
             if(accelerationIsUpdated && attitudeIsUpdated){
-                predictMotionState(acceleration.timestamp());
+                long mergedIntervalMS = motionPredictionMergingInterval();
+                if(isStationary(acceleration.timestamp())){
+                    skipMotionPrediction(acceleration.timestamp());
+                }else if(0 < mergedIntervalMS){
+                    requestMotionPrediction(acceleration.timestamp(), mergedIntervalMS);
+                }else{
+                    flushMotionPrediction();
+                    predictMotionState(acceleration.timestamp());
+                }
             }
 
         }
 
         void putAttitude(const Attitude attitude){
+            MonotonicArena::Scope arenaScope(*mArena);
             initializeStatusIfZero();
             status->step(Status::OTHER);
             
@@ -346,25 +578,201 @@ namespace loc{
             processResetStatus();
         }
         
+        bool isStationary(long timestamp) const{
+            return mStationaryDetector && mStationaryDetector->isStationary(timestamp);
+        }
+        
+        // Prediction noise is frozen while the device is stationary. Only the timestamp of the motion is advanced.
+        void skipMotionPrediction(long timestamp){
+            flushMotionPrediction();
+            if(previousTimestampMotion!=0){
+                previousTimestampMotion = timestamp;
+            }
+        }
+        
+        // The longest interval of the active merging modes, or 0 when a prediction is applied at every motion update.
+        long motionPredictionMergingInterval() const{
+            long interval = mPredictionIntervalMS;
+            if(mMergesMotionPredictions){
+                interval = std::max(interval, mMaxMergedIntervalMS);
+            }
+            if(mScheduler && mScheduler->mergesPredictions()){
+                interval = std::max(interval, mScheduler->parameters().maxMergedIntervalMS);
+            }
+            return std::min(interval, timestampIntervalLimit-1);
+        }
+        
+        // Sensor values at a motion update are applied to the interval since the previous update.
+        void accumulateMotion(long timestamp){
+            long from = mAggregatedUntil!=0 ? mAggregatedUntil : previousTimestampMotion;
+            if(from!=0 && from < timestamp && timestamp - from < timestampIntervalLimit){
+                double dt = timestamp - from;
+                double nSteps = mPedometer->getNSteps();
+                double yaw = mOrientationmeter->getYaw();
+                double yawChange = mLastMotionYawTimestamp==from ? Pose::computeOrientationDifference(mLastMotionYaw, yaw) : 0.0;
+                mAggregatedDuration += dt;
+                mAggregatedIntervals++;
+                if(0 < nSteps){
+                    mAggregatedWalkingDuration += dt;
+                    mAggregatedNSteps = std::max(mAggregatedNSteps, nSteps);
+                    mAggregatedWalkingYawCos += std::cos(yaw)*dt;
+                    mAggregatedWalkingYawSin += std::sin(yaw)*dt;
+                }
+                mAggregatedYawCos += std::cos(yaw)*dt;
+                mAggregatedYawSin += std::sin(yaw)*dt;
+                mAggregatedYawChangeSq += yawChange*yawChange;
+                mAggregatedAngularVelocitySq += yawChange*yawChange/(dt/1000.0);
+            }
+            mAggregatedUntil = timestamp;
+            memorizeMotionYaw(timestamp);
+        }
+        
+        void memorizeMotionYaw(long timestamp){
+            mLastMotionYawTimestamp = timestamp;
+            mLastMotionYaw = mOrientationmeter->getYaw();
+        }
+        
+        void clearAggregatedMotion(){
+            mAggregatedUntil = 0;
+            mAggregatedDuration = 0;
+            mAggregatedWalkingDuration = 0;
+            mAggregatedNSteps = 0;
+            mAggregatedYawCos = 0;
+            mAggregatedYawSin = 0;
+            mAggregatedWalkingYawCos = 0;
+            mAggregatedWalkingYawSin = 0;
+            mAggregatedIntervals = 0;
+            mAggregatedYawChangeSq = 0;
+            mAggregatedAngularVelocitySq = 0;
+        }
+        
+        void requestMotionPrediction(long timestamp, long maxMergedIntervalMS){
+            // Motion before a gap longer than timestampIntervalLimit is predicted separately as without merging.
+            if(mDeferredMotionTimestamp!=0 && timestampIntervalLimit <= timestamp - mDeferredMotionTimestamp){
+                flushMotionPrediction();
+            }
+            accumulateMotion(timestamp);
+            mDeferredMotionTimestamp = timestamp;
+            if(previousTimestampMotion==0 || maxMergedIntervalMS <= timestamp - previousTimestampMotion){
+                flushMotionPrediction();
+            }
+        }
+        
+        void flushMotionPrediction(){
+            if(mDeferredMotionTimestamp!=0){
+                long timestamp = mDeferredMotionTimestamp;
+                mDeferredMotionTimestamp = 0;
+                predictMotionState(timestamp);
+            }
+        }
+        
+        void motionPredictionMerging(bool merges, long maxMergedIntervalMS){
+            if(!merges){
+                flushMotionPrediction();
+            }
+            if(timestampIntervalLimit <= maxMergedIntervalMS){
+                BOOST_THROW_EXCEPTION(LocException("maxMergedIntervalMS must be smaller than timestampIntervalLimit"));
+            }
+            mMergesMotionPredictions = merges;
+            mMaxMergedIntervalMS = maxMergedIntervalMS;
+        }
+        
+        void motionPredictionInterval(long intervalMS){
+            if(timestampIntervalLimit <= intervalMS){
+                BOOST_THROW_EXCEPTION(LocException("motion prediction interval must be smaller than timestampIntervalLimit"));
+            }
+            if(intervalMS <= 0){
+                flushMotionPrediction();
+            }
+            mPredictionIntervalMS = std::max(0L, intervalMS);
+        }
+        
+        void dispatchDeferredCallback(){
+            if(mHasDeferredCallback){
+                mHasDeferredCallback = false;
+                bool defers = mDefersCallback;
+                mDefersCallback = false;
+                callback(status.get());
+                mDefersCallback = defers;
+            }
+        }
+        
+        void putSensorEvents(const SensorEvents& events, const SensorBatchOptions& options, StreamParticleFilter& filter){
+            bool mergesOld = mMergesMotionPredictions;
+            long maxMergedOld = mMaxMergedIntervalMS;
+            motionPredictionMerging(options.mergesIMUSamples, options.maxMergedIntervalMS);
+            mDefersCallback = true;
+            
+            try{
+                long lastCheckpoint = events.empty() ? 0 : events.front().timestamp();
+                for(const auto& event: events){
+                    if(!event.isIMU()){
+                        flushMotionPrediction();
+                    }
+                    filter.putSensorEvent(event);
+                    if(0 < options.checkpointIntervalMS && options.checkpointIntervalMS <= event.timestamp() - lastCheckpoint){
+                        flushMotionPrediction();
+                        dispatchDeferredCallback();
+                        lastCheckpoint = event.timestamp();
+                    }
+                }
+                flushMotionPrediction();
+            }catch(...){
+                mDefersCallback = false;
+                mHasDeferredCallback = false;
+                mDeferredMotionTimestamp = 0;
+                mMergesMotionPredictions = mergesOld;
+                mMaxMergedIntervalMS = maxMergedOld;
+                throw;
+            }
+            mDefersCallback = false;
+            dispatchDeferredCallback();
+            motionPredictionMerging(mergesOld, maxMergedOld);
+        }
+        
         void predictMotionState(long timestamp){
             initializeStatusIfZero();
 
             if(previousTimestampMotion==0){
                 previousTimestampMotion = timestamp;
+                clearAggregatedMotion();
+                memorizeMotionYaw(timestamp);
                 return;
             }
 
             SystemModelInput input;
             input.timestamp(timestamp);
             input.previousTimestamp(previousTimestampMotion);
+            if(0 < mAggregatedDuration && mAggregatedUntil==timestamp){
+                double walkingRate = mAggregatedWalkingDuration/mAggregatedDuration;
+                double coherence = 1.0;
+                if(0 < walkingRate){
+                    // The heading while walking determines the displacement. Its coherence shortens the path around corners.
+                    double yaw = std::atan2(mAggregatedWalkingYawSin, mAggregatedWalkingYawCos);
+                    coherence = std::min(1.0, std::hypot(mAggregatedWalkingYawCos, mAggregatedWalkingYawSin)/mAggregatedWalkingDuration);
+                    input.aggregatedMotion(mAggregatedNSteps, yaw, walkingRate);
+                }else{
+                    input.aggregatedMotion(0.0, std::atan2(mAggregatedYawSin, mAggregatedYawCos), walkingRate);
+                }
+                input.mergedIntervals(mAggregatedIntervals, coherence,
+                                      std::sqrt(mAggregatedYawChangeSq/mAggregatedIntervals),
+                                      std::sqrt(mAggregatedAngularVelocitySq/(mAggregatedDuration/1000.0)));
+            }else{
+                memorizeMotionYaw(timestamp);
+            }
+            clearAggregatedMotion();
 
-            std::shared_ptr<States> states = status->states();
+            auto states = status->states();
             
             bool timestampIntervalIsValid = input.timestamp() - input.previousTimestamp() < timestampIntervalLimit;
             
             if(timestampIntervalIsValid){
+                auto start = std::chrono::steady_clock::now();
                 StatesPtr statesPredicted(new States(mRandomWalker->predict(*states.get(), input)));
                 status->states(statesPredicted, Status::PREDICTION);
+                if(mScheduler){
+                    reportLatency(true, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()-start).count());
+                }
             }else{
                 std::cout << "Interval between two timestamps is too large. The input at timestamp=" << timestamp << " was not used." << std::endl;
             }
@@ -383,12 +791,14 @@ namespace loc{
         }
         
         void putAltimeter(const Altimeter altimeter){
+            flushMotionPrediction();
+            MonotonicArena::Scope arenaScope(*mArena);
             if(mAltitudeManager){
                 mAltitudeManager->putAltimeter(altimeter);
                 
                 // Update states with the altimeter manager.
                 long ts = altimeter.timestamp();
-                std::shared_ptr<States> states = status->states();
+                auto states = status->states();
                 auto statesNew = this->predictFloorTransState(states);
                 status->timestamp(ts);
                 status->states(statesNew);
@@ -396,7 +806,7 @@ namespace loc{
             }
         }
         
-        StatesPtr predictFloorTransState(const StatesPtr& states){
+        StatesPtr predictFloorTransState(const std::shared_ptr<const States>& states){
             auto heightChanged = mAltitudeManager->heightChange();
             const auto& building = mDataStore->getBuilding();
             
@@ -464,8 +874,11 @@ namespace loc{
             return statesNew;
         }
 
-        void logStates(const States& states, const std::string& filename){
-            if(DataLogger::getInstance()){
+        void logStates(const States& states, ParticleTraceRecorder::FrameKind kind, long timestamp){
+            if(mTraceRecorder){
+                mTraceRecorder->record(states, kind, timestamp);
+            }else if(DataLogger::getInstance()){
+                std::string filename = ParticleTraceRecorder::frameKindToString(kind)+"_states_"+std::to_string(timestamp)+".csv";
                 DataLogger::getInstance()->log(filename, DataUtils::statesToCSV(states));
             }
         }
@@ -476,6 +889,7 @@ namespace loc{
             // Generate states
             int burnInLight = mixParams.burnInQuick;
             States statesGen;
+            std::lock_guard<std::mutex> lock(mGenerationMutex);
             if(mMetro){
                 mMetro->input(beacons);
                 mMetro->startBurnIn(burnInLight);
@@ -493,8 +907,10 @@ namespace loc{
             return statesGen;
         }
         
+        // States generated in background are used instead of generating them when a proposal is given.
         States mixStates(const States& states, const Beacons& beacons, const MixtureParameters& mixParams, bool evaluatesLLs,
-                       std::vector<State>& allGeneratedStates, std::vector<double>& allGeneratedStatesLogLLs
+                       std::vector<State>& allGeneratedStates, std::vector<double>& allGeneratedStatesLogLLs,
+                       MixingProposalWorker::Proposal* proposal = nullptr
                        ){
             if( beacons.size() < mixParams.nBeaconsMinimum){
                 return states;
@@ -515,15 +931,24 @@ namespace loc{
                 return states;
             }
             
-            States statesGen = generateStatesForMix(nGen, beacons, mixParams, allGeneratedStates, allGeneratedStatesLogLLs);
+            States statesGen;
+            if(proposal){
+                statesGen = std::move(proposal->states);
+                allGeneratedStates = std::move(proposal->allStates);
+                allGeneratedStatesLogLLs = std::move(proposal->allLogLLs);
+                nGen = std::min(nGen, (int) statesGen.size());
+            }else{
+                statesGen = generateStatesForMix(nGen, beacons, mixParams, allGeneratedStates, allGeneratedStatesLogLLs);
+            }
             
             States statesMixed(states);
             //Location locMean = Location::mean(states);
+            StatesDistanceSummary summary(states, mixDensityCellSize);
             // Copy location of generated states to the existing states.
             for(int i=0; i<nGen; i++){
                 auto& st = statesGen.at(i);
                 //double p = computeStateAcceptProbability(locMean, st); //compate mean state and new state.
-                double p = computeStateAcceptProbability(states, st); //compare all states and new state.
+                double p = computeStateAcceptProbability(summary, st); //compare all states and new state.
                 if(mRand->nextDouble() < p ){
                     int idx = indices.at(i);
                     statesMixed.at(idx).copyLocation(st);
@@ -545,22 +970,12 @@ namespace loc{
             return 0;
         }
         
-        double computeStateAcceptProbability(const States& states, const Location& locNew){
-            size_t n = states.size();
-            double sumDist = 0;
-            double sumIsFloorDifferent = 0;
-            for(const auto& s: states){
-                sumDist += Location::distance(s, locNew);
-                double isFloorDifferent = Location::floorDifference(s, locNew)>0.5 ? 1 : 0;
-                sumIsFloorDifferent += isFloorDifferent;
-            }
-            double meanDist = sumDist/n;
-            double meanIsFloorDifferent = sumIsFloorDifferent/n;
-            
+        double computeStateAcceptProbability(const StatesDistanceSummary& summary, const Location& locNew){
+            double meanIsFloorDifferent = summary.rateFloorDifferent(locNew);
             if(mMixParams.rejectFloorDifference() < meanIsFloorDifferent){
                 return 1;
             }
-            if(mMixParams.rejectDistance < meanDist){
+            if(summary.isMeanDistanceLarger(locNew, mMixParams.rejectDistance)){
                 return 1;
             }
             return 0;
@@ -578,48 +993,125 @@ namespace loc{
 
             long timestamp = beacons.timestamp();
             
+            // While stationary, the likelihoods cached in the states are reused if the states have not changed since they were computed.
+            bool stationary = isStationary(timestamp);
+            bool reusesLikelihoods = stationary && doesFiltering
+                                    && mLikelihoodCacheStates.lock()==status->states()
+                                    && timestamp - mLikelihoodCachedAt < mStationaryDetector->parameters().likelihoodRefreshIntervalMS;
+            
             status->timestamp(timestamp);
-            std::shared_ptr<States> states = status->states();
+            std::shared_ptr<States> states = status->mutableStates();
             
+            bool defersMixing = mScheduler && mScheduler->defersMixing();
             bool passedMonitoringInterval = false;
-            if(timestamp - previousTimestampMonitoring > mLocStatusMonitorParams->monitorIntervalMS() ){
-                passedMonitoringInterval = true;
+            long monitorInterval = mLocStatusMonitorParams->monitorIntervalMS();
+            long elapsedMonitoring = timestamp - previousTimestampMonitoring;
+            if(elapsedMonitoring > monitorInterval){
+                // Mixing under load is deferred until the load decreases or the deferral limit is reached.
+                if(!defersMixing || monitorInterval + mScheduler->parameters().maxMixingDeferralMS < elapsedMonitoring){
+                    passedMonitoringInterval = true;
+                }
+            }
+            bool mixes = passedMonitoringInterval || (mMixParams.mixtureProbability>0 && !defersMixing && !stationary);
+            
+            // With background generation, mixing waits until a proposal generated from recent beacons is available.
+            MixingProposalWorker::Proposal proposal;
+            bool hasProposal = false;
+            if(mMixWorker){
+                if(mixes){
+                    hasProposal = mMixWorker->take(timestamp, mMaxProposalAgeMS, proposal);
+                    if(!hasProposal){
+                        mixes = false;
+                        passedMonitoringInterval = false;
+                    }
+                }
+            }
+            if(passedMonitoringInterval){
                 previousTimestampMonitoring = timestamp;
             }
+            if(mixes){
+                reusesLikelihoods = false;
+            }
+            // Request a proposal for the next update when it will be needed.
+            if(mMixWorker){
+                if(mMixParams.mixtureProbability>0 || monitorInterval < timestamp - previousTimestampMonitoring + mMaxProposalAgeMS){
+                    mMixWorker->request(beacons, countProposalStates((int) states->size(), mMixParams.mixtureProbability));
+                }
+            }
             
             // Compute states mixed with states generated from observations
             std::vector<State> allMixStates;
             std::vector<double> allMixLogLLs;
             States statesMixed;
-            if(passedMonitoringInterval || mMixParams.mixtureProbability>0){
-                statesMixed = mixStates(*states, beacons, mMixParams, passedMonitoringInterval, allMixStates, allMixLogLLs);
+            if(mixes){
+                statesMixed = mixStates(*states, beacons, mMixParams, passedMonitoringInterval, allMixStates, allMixLogLLs, hasProposal ? &proposal : nullptr);
             }else{
                 statesMixed = *states;
             }
+            // Log-likelihoods of a proposal were computed for the beacons it was generated from. They are
+            // recomputed for the current beacons at a monitoring step and not used for monitoring otherwise.
+            if(hasProposal && proposal.timestamp!=timestamp && !allMixLogLLs.empty()){
+                if(monitorsStatus && passedMonitoringInterval){
+                    allMixLogLLs = mObservationModel->computeLogLikelihood(allMixStates, beacons);
+                }else{
+                    allMixLogLLs.clear();
+                }
+            }
             if(doesFiltering){
                 // Logging before weights updated
-                logStates(*states, "before_likelihood_states_"+std::to_string(timestamp)+".csv");
+                logStates(*states, ParticleTraceRecorder::BEFORE_LIKELIHOOD, timestamp);
                 // Copy mixed states when apply filtering
                 *states = statesMixed;
             }
             
+            // Under load, evaluate the likelihood on a weighted subsample and restore the number of states after resampling.
+            size_t nStatesFull = states->size();
+            bool isSubsampled = false;
+            if(doesFiltering && !reusesLikelihoods && mScheduler && mScheduler->subsamplesLikelihood()){
+                const auto& params = mScheduler->parameters();
+                size_t nSub = std::max((size_t) params.minSubsampleStates, (size_t) std::ceil(params.subsampleRate*nStatesFull));
+                if(nSub < nStatesFull){
+                    *states = systematicSample(*states, nSub);
+                    isSubsampled = true;
+                }
+            }
+            
             // Compute log likelihood
-            std::vector<std::vector<double>> vLogLLsAndMDists = mObservationModel->computeLogLikelihoodRelatedValues(*states, beacons);
-            std::vector<double> vLogLLs(states->size());
-            std::vector<double> mDists(states->size());
-            for(int i=0; i<states->size(); i++){
-                vLogLLs[i] = vLogLLsAndMDists.at(i).at(0);
-                mDists[i] = vLogLLsAndMDists.at(i).at(1);
+            MonotonicArena* arena = mArena->isActiveInCurrentThread() ? mArena.get() : nullptr;
+            ArenaVector<double> vLogLLs(states->size(), 0.0, ArenaAllocator<double>(arena));
+            ArenaVector<double> mDists(states->size(), 0.0, ArenaAllocator<double>(arena));
+            if(reusesLikelihoods){
+                for(int i=0; i<states->size(); i++){
+                    vLogLLs[i] = -states->at(i).negativeLogLikelihood();
+                    mDists[i] = states->at(i).mahalanobisDistance();
+                }
+            }else{
+                mObservationModel->computeLogLikelihoodRelatedValues(*states, beacons, vLogLLs.data(), mDists.data());
+            }
+            
+            // Update weights, normalize them and compute ESS in a fused kernel.
+            // vLogLLs stay unweakened (alpha-weakening is applied once inside) and mWeights holds the normalized weights after this call.
+            int nStates = (int) states->size();
+            double ess = 0;
+            double maxCurrentLogLL = std::numeric_limits<double>::lowest();
+            double avgCurrentLogLL = 0;
+            if(doesFiltering){
+                mWeights.resize(nStates);
+                for(int i=0; i<nStates; i++){
+                    mWeights[i] = states->at(i).weight();
+                }
+                ess = ArrayUtils::updateWeightsFromLogLikelihood(vLogLLs.data(), mWeights.data(), nStates, mAlphaWeaken, maxCurrentLogLL, avgCurrentLogLL);
+            }else if(monitorsStatus){
+                avgCurrentLogLL = std::accumulate(vLogLLs.begin(), vLogLLs.end(), 0.0)/vLogLLs.size();
+                maxCurrentLogLL = *std::max_element(vLogLLs.begin(), vLogLLs.end());
             }
             
             if(monitorsStatus){
                 // Update locationStatus by comparing likelihoods between states and one-shot states
                 
-                double avgCurrentLogLL = std::accumulate(vLogLLs.begin(), vLogLLs.end(), 0.0)/vLogLLs.size();
                 double avgMixLogLL = std::accumulate(allMixLogLLs.begin(), allMixLogLLs.end(), 0.0)/allMixLogLLs.size();
                 
                 if(!isnan(avgMixLogLL)){
-                    double maxCurrentLogLL = *std::max_element(vLogLLs.begin(), vLogLLs.end());
                     double maxMixLogLL = *std::max_element(allMixLogLLs.begin(), allMixLogLLs.end());
                     
                     double weightAvgLogLL = std::exp(avgCurrentLogLL)/(std::exp(avgCurrentLogLL)+std::exp(avgMixLogLL));
@@ -650,24 +1142,7 @@ namespace loc{
             }
             
             if(doesFiltering){
-                // Apply alpha-weaken
-                vLogLLs = weakenLogLikelihoods(vLogLLs, mAlphaWeaken);
-                
-                // Set negative log-likelihoods
-                for(int i=0; i<vLogLLs.size(); i++){
-                    State& s = states->at(i);
-                    s.negativeLogLikelihood(-vLogLLs.at(i));
-                    s.mahalanobisDistance(mDists.at(i));
-                }
-                
-                std::vector<double> weights = ArrayUtils::computeWeightsFromLogLikelihood(vLogLLs);
-                double sumWeights = 0;
-                // Multiply loglikelihood-based weights and particle weights.
-                for(int i=0; i<weights.size(); i++){
-                    weights[i] = weights[i] * (states->at(i).weight());
-                    sumWeights += weights[i];
-                }
-                if(sumWeights<=0){
+                if(ess<=0){
                     LocException ex("sum(weights) <= 0");
                     for(auto logLL: vLogLLs){
                         if(logLL == 0){
@@ -677,17 +1152,18 @@ namespace loc{
                     }
                     BOOST_THROW_EXCEPTION(ex);
                 }
-                // Renormalized
-                for(int i=0; i<weights.size(); i++){
-                    weights[i] = weights[i]/sumWeights;
-                    states->at(i).weight(weights[i]);
+                // Set unweakened negative log-likelihoods, which are reused while stationary, and renormalized weights
+                for(int i=0; i<nStates; i++){
+                    State& s = states->at(i);
+                    s.negativeLogLikelihood(-vLogLLs[i]);
+                    s.mahalanobisDistance(mDists[i]);
+                    s.weight(mWeights[i]);
                 }
                 
                 // Logging after weights updated
-                logStates(*states, "after_likelihood_states_"+std::to_string(timestamp)+".csv");
+                logStates(*states, ParticleTraceRecorder::AFTER_LIKELIHOOD, timestamp);
                 
                 // Resampling step
-                double ess = computeESS(weights);
                 if(mOptVerbose){
                     std::cout << "ESS=" << ess << std::endl;
                 }
@@ -695,29 +1171,40 @@ namespace loc{
                 Status::Step step;
                 
                 if(ess<=mEssThreshold){
-                    statesNew.reset(mResampler->resample(*states, &weights[0]));
+                    // Resample in place to reuse the storage of the current states
+                    mResampler->resampleInPlace(*states, mWeights.data());
+                    statesNew = states;
                     // Assign equal weights after resampling
-                    for(int i=0; i<weights.size(); i++){
-                        double weight = 1.0/(weights.size());
+                    double weight = 1.0/nStates;
+                    for(int i=0; i<nStates; i++){
                         statesNew->at(i).weight(weight);
                     }
                     step = Status::FILTERING_WITH_RESAMPLING;
                 }else{
-                    statesNew.reset(new States(*states));
+                    statesNew = states;
                     step = Status::FILTERING_WITHOUT_RESAMPLING;
                 }
                 
-                // Posterior-resampling
-                if(mPostResampler){
+                // Posterior-resampling (skipped while stationary to keep the states unchanged)
+                if(mPostResampler && !stationary){
                     *statesNew = mPostResampler->resample(*statesNew);
                 }
                 
+                if(isSubsampled){
+                    *statesNew = systematicSample(*statesNew, nStatesFull);
+                    step = Status::FILTERING_WITH_RESAMPLING;
+                }
+                
                 status->states(statesNew, step);
+                mLikelihoodCacheStates = status->states();
+                if(!reusesLikelihoods){
+                    mLikelihoodCachedAt = timestamp;
+                }
                 if(mOptVerbose){
                     std::cout << "resampling at t=" << beacons.timestamp() << std::endl;
                 }
                 // Logging after resampling
-                logStates(*statesNew, "resampled_states_"+std::to_string(timestamp)+".csv");
+                logStates(*statesNew, ParticleTraceRecorder::RESAMPLED, timestamp);
                 
                 // Notify registered instances of the update of particle fiter
                 this->notifyObservationUpdated();
@@ -726,17 +1213,43 @@ namespace loc{
             }
         }
 
-        void notifyObservationUpdated(){
-            mRandomWalker->notifyObservationUpdated();
+        // The number of states replaced in mixing is binomial. Enough states are requested to cover it in most updates.
+        int countProposalStates(int nStates, double mixtureProbability){
+            if(mixtureProbability<=0){
+                return 0;
+            }
+            double mean = nStates*mixtureProbability;
+            double stdev = std::sqrt(mean*(1.0-mixtureProbability));
+            return std::min(nStates, (int) std::ceil(mean + 4*stdev) + 1);
         }
         
-        double computeESS(std::vector<double> weights){
-            double val = 0;
-            for(double w : weights){
-                val += w*w;
+        // Draws n states with probabilities proportional to their weights by systematic sampling. The drawn states have equal weights.
+        States systematicSample(const States& states, size_t n){
+            size_t m = states.size();
+            double sumWeights = 0;
+            for(const auto& s: states){
+                sumWeights += s.weight();
             }
-            double ess = 1.0/val;
-            return ess;
+            States sampled;
+            sampled.reserve(n);
+            double step = sumWeights/n;
+            double u = step*mRand->nextDouble();
+            double cumsum = states[0].weight();
+            size_t j = 0;
+            for(size_t i=0; i<n; i++){
+                while(cumsum < u && j+1 < m){
+                    j++;
+                    cumsum += states[j].weight();
+                }
+                sampled.push_back(states[j]);
+                sampled.back().weight(1.0/n);
+                u += step;
+            }
+            return sampled;
+        }
+        
+        void notifyObservationUpdated(){
+            mRandomWalker->notifyObservationUpdated();
         }
         
         Beacons filterBeacons(const Beacons& beacons){
@@ -794,13 +1307,18 @@ namespace loc{
         }
         
         void putBeacons(const Beacons& beacons){
+            flushMotionPrediction();
+            auto start = std::chrono::steady_clock::now();
+            MonotonicArena::Scope arenaScope(*mArena);
             initializeStatusIfZero();
             status->step(Status::OTHER);
             
             const Beacons& beaconsFiltered = filterBeacons(beacons);
+            if(mStationaryDetector){
+                mStationaryDetector->putBeacons(beaconsFiltered);
+            }
             if(beaconsFiltered.size()>0){
                 // Observation dependent floor update
-                std::shared_ptr<States> states = status->states();
                 bool tryFloorUpdate = false;
                 if(mEnablesFloorUpdate){
                     if(!mFloorUpdater){
@@ -813,12 +1331,14 @@ namespace loc{
                     }
                     tryFloorUpdate = checkTryFloorUpdate();
                     if(tryFloorUpdate){
+                        auto states = status->mutableStates();
                         mFloorUpdater->floorUpdate(*states, beaconsFiltered);
                         status->states(states);// update states to compute rep values.
+                        mLikelihoodCacheStates.reset();
                     }
                 }
                 // filtering
-                bool doesFiltering = checkIfDoFiltering(*states);
+                bool doesFiltering = checkIfDoFiltering(*status);
                 bool monitorsStatus = true;
                 
                 if(doesFiltering){
@@ -841,27 +1361,25 @@ namespace loc{
                 status->step(Status::OBSERVATION_WITHOUT_FILTERING);
             }
             status->timestamp(beacons.timestamp());
+            if(mScheduler){
+                reportLatency(false, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()-start).count());
+            }
             callback(status.get());
         };
 
-        static std::vector<double> weakenLogLikelihoods(std::vector<double> logLikelihoods, double alphaWeaken){
-            size_t n = logLikelihoods.size();
-            std::vector<double> weakenedLogLLs(n);
-            for(int i=0; i<n; i++){
-                weakenedLogLLs[i] = alphaWeaken*logLikelihoods[i];
-            }
-            return weakenedLogLLs;
-        }
-
         void reset(){
             previousTimestampMotion = 0;
+            mDeferredMotionTimestamp = 0;
+            clearAggregatedMotion();
         }
 
         void initializeStatus(){
             this->reset();
             mPedometer->reset();
             mOrientationmeter->reset();
+            std::unique_lock<std::mutex> lock(mGenerationMutex);
             StatesPtr states(new States(mStatusInitializer->initializeStates(mNumStates)));
+            lock.unlock();
             updateStatus(states);
         }
 
@@ -880,6 +1398,49 @@ namespace loc{
             mUserData = inUserData;
         }
         
+        void backgroundMixing(bool enables, long maxProposalAgeMS){
+            mMaxProposalAgeMS = maxProposalAgeMS;
+            if(enables && !mMixWorker){
+                mMixWorker.reset(new MixingProposalWorker([this](const Beacons& beacons, int nStates, MixingProposalWorker::Proposal& proposal){
+                    MixtureParameters mixParams;
+                    {
+                        std::lock_guard<std::mutex> lock(mGenerationMutex);
+                        mixParams = mMixParams;
+                    }
+                    proposal.states = generateStatesForMix(nStates, beacons, mixParams, proposal.allStates, proposal.allLogLLs);
+                }));
+            }else if(!enables){
+                mMixWorker.reset();
+            }
+        }
+        
+        // Level changes of the scheduler are logged in the verbose mode.
+        void reportLatency(bool isPrediction, double ms){
+            DeadlineScheduler::Level level = mScheduler->level();
+            if(isPrediction){
+                mScheduler->reportPredictionLatency(ms);
+            }else{
+                mScheduler->reportUpdateLatency(ms);
+            }
+            if(mOptVerbose && level != mScheduler->level()){
+                std::cout << "degradation level changed from " << DeadlineScheduler::levelToString(level)
+                << " to " << DeadlineScheduler::levelToString(mScheduler->level()) << " (load=" << mScheduler->load() << ")" << std::endl;
+            }
+        }
+        
+        void deadlineScheduler(DeadlineScheduler::Ptr scheduler){
+            mScheduler = scheduler;
+        }
+        
+        void stationaryDetector(StationaryDetector::Ptr detector){
+            mStationaryDetector = detector;
+            mLikelihoodCacheStates.reset();
+        }
+        
+        void particleTraceRecorder(ParticleTraceRecorder::Ptr recorder){
+            mTraceRecorder = recorder;
+        }
+        
         void dataStore(DataStore::Ptr dataStore){
             mDataStore = dataStore;
         }
@@ -889,11 +1450,16 @@ namespace loc{
         };
 
         bool resetStatus(){
+            flushMotionPrediction();
             initializeStatus();
             return true;
         }
 
         void callback(Status* status){
+            if(mDefersCallback){
+                mHasDeferredCallback = true;
+                return;
+            }
             if(mFunctionCalledAfterUpdate!=NULL){
                 mFunctionCalledAfterUpdate(status);
             }
@@ -903,11 +1469,14 @@ namespace loc{
         }
 
         bool resetStatus(Pose pose){
+            flushMotionPrediction();
             bool orientationWasUpdated = mOrientationmeter->isUpdated();
             if(orientationWasUpdated){
                 std::cout << "Orientation is updated. Reset succeeded." << std::endl;
                 double orientationMeasured = mOrientationmeter->getYaw();
+                std::unique_lock<std::mutex> lock(mGenerationMutex);
                 StatesPtr states(new States(mStatusInitializer->resetStates(mNumStates, pose, orientationMeasured)));
+                lock.unlock();
                 status->states(states, Status::RESET);
                 callback(status.get());
                 return true;
@@ -922,11 +1491,14 @@ namespace loc{
         }
 
         bool resetStatus(Pose meanPose, Pose stdevPose){
+            flushMotionPrediction();
             bool orientationWasUpdated = mOrientationmeter->isUpdated();
             if(orientationWasUpdated){
                 std::cout << "Orientation is updated. Reset succeeded." << std::endl;
                 double orientationMeasured = mOrientationmeter->getYaw();
+                std::unique_lock<std::mutex> lock(mGenerationMutex);
                 StatesPtr states(new States(mStatusInitializer->resetStates(mNumStates, meanPose, stdevPose, orientationMeasured)));
+                lock.unlock();
                 status->states(states, Status::RESET);
                 callback(status.get());
                 return true;
@@ -941,11 +1513,14 @@ namespace loc{
         }
         
         bool resetStatus(Pose meanPose, Pose stdevPose, double rateContami){
+            flushMotionPrediction();
             bool orientationWasUpdated = mOrientationmeter->isUpdated();
             if(orientationWasUpdated){
                 std::cout << "Orientation is updated. Reset(meanPose, stdevPose, rateContami) succeeded." << std::endl;
                 double orientationMeasured = mOrientationmeter->getYaw();
+                std::unique_lock<std::mutex> lock(mGenerationMutex);
                 auto statesTmp = mStatusInitializer->resetStates(mNumStates, meanPose, stdevPose, orientationMeasured);
+                lock.unlock();
                 for(auto& s: statesTmp){
                     double d = mRand->nextDouble();
                     if(d<rateContami){
@@ -970,6 +1545,8 @@ namespace loc{
         }
 
         bool resetStatus(const Beacons& beacons){
+            flushMotionPrediction();
+            MonotonicArena::Scope arenaScope(*mArena);
             initializeStatusIfZero();
             Beacons beaconsFiltered = filterBeacons(beacons);
             if(mDataStore && mFiltersBeaconFloorAtReset){
@@ -997,6 +1574,7 @@ namespace loc{
         States sampleStatesByObservation(int n, const Beacons& beacons){
             const Beacons& beaconsFiltered = filterBeacons(beacons);
             States statesNew;
+            std::lock_guard<std::mutex> lock(mGenerationMutex);
             if(mMetro){
                 mMetro->input(beaconsFiltered);
                 mMetro->startBurnIn();
@@ -1013,6 +1591,8 @@ namespace loc{
         }
         
         bool resetStatus(const Location& location, const Beacons& beacons){
+            flushMotionPrediction();
+            MonotonicArena::Scope arenaScope(*mArena);
             initializeStatusIfZero();
             const Beacons& beaconsFiltered = filterBeacons(beacons);
             std::stringstream ss;
@@ -1033,6 +1613,7 @@ namespace loc{
         States sampleStatesByLocationAndObservation(int n, const Location& location, const Beacons& beacons){
             const Beacons& beaconsFiltered = filterBeacons(beacons);
             States statesNew;
+            std::lock_guard<std::mutex> lock(mGenerationMutex);
             if(mMetro){
                 mMetro->input(beaconsFiltered);
                 statesNew = mMetro->sampling(n, location);
@@ -1047,20 +1628,23 @@ namespace loc{
 
 
         bool refineStatus(const Beacons& beacons){
+            flushMotionPrediction();
+            MonotonicArena::Scope arenaScope(*mArena);
             // TODO
             BOOST_THROW_EXCEPTION(LocException("unsupported method"));
             
             const Beacons& beaconsFiltered = filterBeacons(beacons);
 
             if(beaconsFiltered.size()>0){
-                auto states = status->states();
-                if(checkIfDoFiltering(*states)){
+                if(checkIfDoFiltering(*status)){
                     doFiltering(beaconsFiltered);
                 }
             }
-            std::shared_ptr<States> statesTmp = status->states();
+            auto statesTmp = status->states();
             std::vector<Location> locations(statesTmp->begin(), statesTmp->end());
+            std::unique_lock<std::mutex> lock(mGenerationMutex);
             StatesPtr statesNew(new States(mStatusInitializer->initializeStatesFromLocations(locations)));
+            lock.unlock();
             status->timestamp(beacons.timestamp());
             status->states(statesNew, Status::RESET);
             callback(status.get());
@@ -1069,6 +1653,7 @@ namespace loc{
 
         void processResetStatus(){
             if(functionsForReset.size()>0){
+                flushMotionPrediction();
                 bool orientationWasUpdated = mOrientationmeter->isUpdated();
                 if(orientationWasUpdated){
                     std::function<void()> func = functionsForReset.back();
@@ -1079,13 +1664,14 @@ namespace loc{
             }
         }
 
-        bool checkIfDoFiltering(const States& states) const{
+        bool checkIfDoFiltering(const Status& st) const{
             double variance2DLowerBound = std::pow(mLocStdevLB.x(), 2)*std::pow(mLocStdevLB.y(),2);
             double stdZLB = mLocStdevLB.z();
             double stdFloorLB = mLocStdevLB.floor();
             
-            double variance2D = Location::compute2DVariance(states);
-            Location stdevLoc = Location::standardDeviation(states);
+            auto moments = st.moments();
+            double variance2D = moments->variance2D;
+            const Location& stdevLoc = moments->stdevLocation;
             
             if(mOptVerbose){
                 std::cout<<"var2D="<<variance2D<<","<<"var2DLB="<<variance2DLowerBound
@@ -1119,6 +1705,7 @@ namespace loc{
         }
         
         void mixtureParameters(MixtureParameters mixParams){
+            std::lock_guard<std::mutex> lock(mGenerationMutex);
             mMixParams = mixParams;
         }
 
@@ -1148,6 +1735,7 @@ namespace loc{
 
         void observationModel(std::shared_ptr<ObservationModel<State, Beacons>> observationModel){
             mObservationModel = observationModel;
+            mObservationModel->arena(mArena);
         }
 
         void resampler(std::shared_ptr<Resampler<State>> resampler){
@@ -1155,6 +1743,7 @@ namespace loc{
         }
 
         void statusInitializer(std::shared_ptr<StatusInitializer> statusInitializer){
+            std::lock_guard<std::mutex> lock(mGenerationMutex);
             mStatusInitializer = statusInitializer;
         }
 
@@ -1163,6 +1752,7 @@ namespace loc{
         }
 
         void observationDependentInitializer(std::shared_ptr<ObservationDependentInitializer<State, Beacons>> metro){
+            std::lock_guard<std::mutex> lock(mGenerationMutex);
             mMetro = metro;
         }
         
@@ -1216,6 +1806,21 @@ namespace loc{
         return *this;
     }
     
+    StreamParticleFilter& StreamParticleFilter::putSensorEvents(const SensorEvents& events, const SensorBatchOptions& options) {
+        impl->putSensorEvents(events, options, *this);
+        return *this;
+    }
+    
+    StreamParticleFilter& StreamParticleFilter::motionPredictionMerging(bool merges, long maxMergedIntervalMS) {
+        impl->motionPredictionMerging(merges, maxMergedIntervalMS);
+        return *this;
+    }
+    
+    StreamParticleFilter& StreamParticleFilter::flushMotionPrediction() {
+        impl->flushMotionPrediction();
+        return *this;
+    }
+    
     StreamParticleFilter& StreamParticleFilter::updateHandler(void (*functionCalledAfterUpdate)(Status*)) {
         impl->updateHandler(functionCalledAfterUpdate);
         return *this;
@@ -1340,6 +1945,31 @@ namespace loc{
         return * this;
     }
 
+    StreamParticleFilter& StreamParticleFilter::motionPredictionInterval(long intervalMS){
+        impl->motionPredictionInterval(intervalMS);
+        return *this;
+    }
+    
+    StreamParticleFilter& StreamParticleFilter::backgroundMixing(bool enables, long maxProposalAgeMS){
+        impl->backgroundMixing(enables, maxProposalAgeMS);
+        return *this;
+    }
+    
+    StreamParticleFilter& StreamParticleFilter::stationaryDetector(StationaryDetector::Ptr detector){
+        impl->stationaryDetector(detector);
+        return *this;
+    }
+    
+    StreamParticleFilter& StreamParticleFilter::deadlineScheduler(DeadlineScheduler::Ptr scheduler){
+        impl->deadlineScheduler(scheduler);
+        return *this;
+    }
+    
+    StreamParticleFilter& StreamParticleFilter::particleTraceRecorder(ParticleTraceRecorder::Ptr recorder){
+        impl->particleTraceRecorder(recorder);
+        return *this;
+    }
+    
     StreamParticleFilter& StreamParticleFilter::dataStore(DataStore::Ptr dataStore){
         impl->dataStore(dataStore);
         return * this;
@@ -36,6 +36,9 @@
 
 #include "BeaconFilter.hpp"
 #include "AltitudeManager.hpp"
+#include "ParticleTraceRecorder.hpp"
+#include "DeadlineScheduler.hpp"
+#include "StationaryDetector.hpp"
 
 namespace loc {
     
@@ -139,6 +142,16 @@ namespace loc {
         StreamParticleFilter& observationDependentInitializer(std::shared_ptr<ObservationDependentInitializer<State, Beacons>> metro);
         StreamParticleFilter& posteriorResampler(PosteriorResampler<State>::Ptr);
         StreamParticleFilter& dataStore(DataStore::Ptr);
+        // Particle sets are recorded to the binary trace instead of the CSV files of DataLogger when set.
+        StreamParticleFilter& particleTraceRecorder(ParticleTraceRecorder::Ptr);
+        // States for mixing are generated on a background thread from the latest beacons and consumed at a later update.
+        // Proposals older than maxProposalAgeMS are dropped.
+        StreamParticleFilter& backgroundMixing(bool enables, long maxProposalAgeMS = 1500);
+        // Degrades mixing, likelihood evaluation and prediction according to the measured latency when set.
+        StreamParticleFilter& deadlineScheduler(DeadlineScheduler::Ptr);
+        // While the detector reports a stationary device, motion predictions are skipped, cached likelihoods are reused
+        // and per-update mixing is suspended.
+        StreamParticleFilter& stationaryDetector(StationaryDetector::Ptr);
         
         // callback function setter
         StreamParticleFilter& updateHandler(void (*functionCalledAfterUpdate)(Status*)) override;
@@ -150,8 +163,17 @@ namespace loc {
         StreamParticleFilter& putBeacons(const Beacons beacons) override;
         StreamParticleFilter& putLocalHeading(const LocalHeading heading) override;
         StreamParticleFilter& putAltimeter(const Altimeter altimeter) override;
+        StreamParticleFilter& putSensorEvents(const SensorEvents& events, const SensorBatchOptions& options) override;
         Status* getStatus() override;
         
+        // While merging, motion predictions requested by consecutive accelerations are deferred and applied once
+        // before the next non-IMU input, by flushMotionPrediction(), or when maxMergedIntervalMS has elapsed.
+        StreamParticleFilter& motionPredictionMerging(bool merges, long maxMergedIntervalMS);
+        StreamParticleFilter& flushMotionPrediction();
+        // Applies motion predictions of streaming input at most every intervalMS and before each non-IMU input.
+        // Pedometer and orientation meter values are aggregated over the merged interval. 0 predicts at every motion update.
+        StreamParticleFilter& motionPredictionInterval(long intervalMS);
+        
         // optional methods
         bool resetStatus() override;
         bool resetStatus(Pose pose) override;
@@ -78,12 +78,12 @@ void functionCalledWhenUpdated(void *userData, loc::Status *pStatus) {
             clock_t now = clock();
             if (now > ud->lastShowDebugInfo + CLOCKS_PER_SEC) {
                 ud->lastShowDebugInfo = now;
-                std::shared_ptr<std::vector<loc::State>> states = pStatus->states();
+                auto states = pStatus->states();
                 int size = states->size();
                 jdouble buff[size * 2];
                 jdouble buff2[size * 2];
                 for (int i = 0; i < size; i++) {
-                    loc::State s = states->at(i);
+                    const loc::State& s = states->at(i);
                     auto g = projection->localToGlobal(s);
                     buff[i * 2] = s.x();
                     buff[i * 2 + 1] = s.y();
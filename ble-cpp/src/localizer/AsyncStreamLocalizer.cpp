@@ -0,0 +1,367 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#include "AsyncStreamLocalizer.hpp"
+#include <algorithm>
+#include <iostream>
+
+namespace loc{
+    
+    AsyncStreamLocalizer::AsyncStreamLocalizer(std::shared_ptr<StreamLocalizer> localizer)
+    : AsyncStreamLocalizer(localizer, Parameters())
+    {}
+    
+    AsyncStreamLocalizer::AsyncStreamLocalizer(std::shared_ptr<StreamLocalizer> localizer, Parameters params)
+    : mLocalizer(localizer), mParams(params),
+    mAccelerationChannel(params.queueCapacity), mAttitudeChannel(params.queueCapacity),
+    mBeaconsChannel(params.queueCapacity), mLocalHeadingChannel(params.queueCapacity),
+    mAltimeterChannel(params.queueCapacity)
+    {
+        if(!mLocalizer){
+            BOOST_THROW_EXCEPTION(LocException("localizer is not set"));
+        }
+        mWorker = std::thread(&AsyncStreamLocalizer::run, this);
+    }
+    
+    AsyncStreamLocalizer::~AsyncStreamLocalizer(){
+        mRunning.store(false);
+        {
+            std::lock_guard<std::mutex> lock(mWakeMutex);
+        }
+        mWakeCV.notify_one();
+        // The worker applies the remaining inputs before it exits.
+        if(mWorker.joinable()){
+            mWorker.join();
+        }
+        if(mError){
+            try{
+                std::rethrow_exception(mError);
+            }catch(std::exception& ex){
+                std::cerr << "AsyncStreamLocalizer: " << ex.what() << std::endl;
+            }
+        }
+    }
+    
+    AsyncStreamLocalizer& AsyncStreamLocalizer::updateHandler(void (*functionCalledAfterUpdate)(Status*)){
+        std::lock_guard<std::recursive_mutex> lock(mConsumerMutex);
+        mLocalizer->updateHandler(functionCalledAfterUpdate);
+        return *this;
+    }
+    
+    AsyncStreamLocalizer& AsyncStreamLocalizer::updateHandler(void (*functionCalledAfterUpdate)(void*, Status*), void* inUserData){
+        std::lock_guard<std::recursive_mutex> lock(mConsumerMutex);
+        mLocalizer->updateHandler(functionCalledAfterUpdate, inUserData);
+        return *this;
+    }
+    
+    template<class T>
+    void AsyncStreamLocalizer::enqueue(Channel<T>& channel, SensorType type, const T& item){
+        Counter& counter = mCounters[type];
+        // Once an input is kept in the latest-wins slot, newer inputs go to the slot too until the worker takes it,
+        // so that the queue never holds an input newer than the one in the slot.
+        if(channel.latest.pending() || !channel.queue.push(item)){
+            if(channel.latest.put(item)){
+                if(type==ACCELERATION || type==ATTITUDE){
+                    counter.coalesced++;
+                }else{
+                    counter.dropped++;
+                }
+            }
+        }
+        counter.received++;
+        size_t depth = depthOf(channel);
+        if(counter.maxQueueDepth.load(std::memory_order_relaxed) < depth){
+            counter.maxQueueDepth.store(depth, std::memory_order_relaxed);
+        }
+        wake();
+    }
+    
+    template<class T>
+    size_t AsyncStreamLocalizer::depthOf(const Channel<T>& channel){
+        return channel.queue.size() + (channel.latest.pending() ? 1 : 0);
+    }
+    
+    void AsyncStreamLocalizer::wake(){
+        // Pairs with the fence in run(): either the worker sees the pushed input before it sleeps,
+        // or this thread sees mSleeping and notifies it under the mutex.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if(mSleeping.load(std::memory_order_relaxed)){
+            {
+                std::lock_guard<std::mutex> lock(mWakeMutex);
+            }
+            mWakeCV.notify_one();
+        }
+    }
+    
+    void AsyncStreamLocalizer::rethrowError(){
+        if(!mHasError.load(std::memory_order_acquire)){
+            return;
+        }
+        std::exception_ptr error;
+        {
+            std::lock_guard<std::mutex> lock(mErrorMutex);
+            std::swap(error, mError);
+            mHasError.store(false, std::memory_order_relaxed);
+        }
+        if(error){
+            std::rethrow_exception(error);
+        }
+    }
+    
+    template<class T>
+    void AsyncStreamLocalizer::drain(Channel<T>& channel, std::vector<T>& items){
+        // The slot is taken before the queue is drained: the queue holds every input older than the one in the slot,
+        // and any input pushed after the slot was taken is newer than all inputs taken here.
+        size_t begin = items.size();
+        bool hasLatest = channel.latest.consume([&](T& item){items.push_back(std::move(item));});
+        channel.queue.consumeAll([&](T& item){items.push_back(std::move(item));});
+        if(hasLatest){
+            std::stable_sort(items.begin() + begin, items.end(), [](const T& a, const T& b){
+                return a.timestamp() < b.timestamp();
+            });
+        }
+    }
+    
+    AsyncStreamLocalizer& AsyncStreamLocalizer::putAcceleration(const Acceleration acceleration){
+        rethrowError();
+        enqueue(mAccelerationChannel, ACCELERATION, acceleration);
+        return *this;
+    }
+    
+    AsyncStreamLocalizer& AsyncStreamLocalizer::putAttitude(const Attitude attitude){
+        rethrowError();
+        enqueue(mAttitudeChannel, ATTITUDE, attitude);
+        return *this;
+    }
+    
+    AsyncStreamLocalizer& AsyncStreamLocalizer::putBeacons(const Beacons beacons){
+        rethrowError();
+        enqueue(mBeaconsChannel, BEACONS, beacons);
+        return *this;
+    }
+    
+    AsyncStreamLocalizer& AsyncStreamLocalizer::putLocalHeading(const LocalHeading heading){
+        rethrowError();
+        enqueue(mLocalHeadingChannel, LOCAL_HEADING, heading);
+        return *this;
+    }
+    
+    AsyncStreamLocalizer& AsyncStreamLocalizer::putAltimeter(const Altimeter altimeter){
+        rethrowError();
+        enqueue(mAltimeterChannel, ALTIMETER, altimeter);
+        return *this;
+    }
+    
+    Status* AsyncStreamLocalizer::getStatus(){
+        std::lock_guard<std::recursive_mutex> lock(mConsumerMutex);
+        return mLocalizer->getStatus();
+    }
+    
+    bool AsyncStreamLocalizer::resetStatus(){
+        std::lock_guard<std::recursive_mutex> lock(mConsumerMutex);
+        return mLocalizer->resetStatus();
+    }
+    
+    bool AsyncStreamLocalizer::resetStatus(Pose pose){
+        std::lock_guard<std::recursive_mutex> lock(mConsumerMutex);
+        return mLocalizer->resetStatus(pose);
+    }
+    
+    bool AsyncStreamLocalizer::resetStatus(Pose meanPose, Pose stdevPose){
+        std::lock_guard<std::recursive_mutex> lock(mConsumerMutex);
+        return mLocalizer->resetStatus(meanPose, stdevPose);
+    }
+    
+    bool AsyncStreamLocalizer::resetStatus(Pose meanPose, Pose stdevPose, double rateContami){
+        std::lock_guard<std::recursive_mutex> lock(mConsumerMutex);
+        return mLocalizer->resetStatus(meanPose, stdevPose, rateContami);
+    }
+    
+    bool AsyncStreamLocalizer::resetStatus(const Beacons& beacons){
+        std::lock_guard<std::recursive_mutex> lock(mConsumerMutex);
+        return mLocalizer->resetStatus(beacons);
+    }
+    
+    bool AsyncStreamLocalizer::resetStatus(const Location& location, const Beacons& beacons){
+        std::lock_guard<std::recursive_mutex> lock(mConsumerMutex);
+        return mLocalizer->resetStatus(location, beacons);
+    }
+    
+    void AsyncStreamLocalizer::flush(){
+        processPending();
+        rethrowError();
+    }
+    
+    AsyncSensorMetrics AsyncStreamLocalizer::metrics() const{
+        auto toCounter = [](const Counter& c, size_t depth){
+            AsyncSensorCounter ac;
+            ac.received = c.received;
+            ac.processed = c.processed;
+            ac.dropped = c.dropped;
+            ac.coalesced = c.coalesced;
+            ac.queueDepth = depth;
+            ac.maxQueueDepth = c.maxQueueDepth;
+            return ac;
+        };
+        AsyncSensorMetrics m;
+        m.acceleration = toCounter(mCounters[ACCELERATION], depthOf(mAccelerationChannel));
+        m.attitude = toCounter(mCounters[ATTITUDE], depthOf(mAttitudeChannel));
+        m.beacons = toCounter(mCounters[BEACONS], depthOf(mBeaconsChannel));
+        m.localHeading = toCounter(mCounters[LOCAL_HEADING], depthOf(mLocalHeadingChannel));
+        m.altimeter = toCounter(mCounters[ALTIMETER], depthOf(mAltimeterChannel));
+        return m;
+    }
+    
+    std::shared_ptr<StreamLocalizer> AsyncStreamLocalizer::localizer() const{
+        return mLocalizer;
+    }
+    
+    bool AsyncStreamLocalizer::hasPending() const{
+        return depthOf(mAccelerationChannel) > 0 || depthOf(mAttitudeChannel) > 0 || depthOf(mBeaconsChannel) > 0
+        || depthOf(mLocalHeadingChannel) > 0 || depthOf(mAltimeterChannel) > 0;
+    }
+    
+    // Keeps the newest maxSize items of a timestamp-ordered buffer.
+    template<class T>
+    long keepLatest(std::vector<T>& items, size_t maxSize){
+        if(items.size() <= maxSize){
+            return 0;
+        }
+        long nRemoved = items.size() - maxSize;
+        items.erase(items.begin(), items.begin() + nRemoved);
+        return nRemoved;
+    }
+    
+    void AsyncStreamLocalizer::processPending(){
+        std::lock_guard<std::recursive_mutex> lock(mConsumerMutex);
+        
+        mAccelerations.clear();
+        mAttitudes.clear();
+        mBeaconsFrames.clear();
+        mLocalHeadings.clear();
+        mAltimeters.clear();
+        // Attitudes are drained before accelerations so that every acceleration older than a drained attitude
+        // is drained too and no attitude is applied before an older acceleration.
+        drain(mAttitudeChannel, mAttitudes);
+        drain(mAccelerationChannel, mAccelerations);
+        drain(mBeaconsChannel, mBeaconsFrames);
+        drain(mLocalHeadingChannel, mLocalHeadings);
+        drain(mAltimeterChannel, mAltimeters);
+        
+        if(mParams.dropsSupersededBeacons){
+            mCounters[BEACONS].coalesced += keepLatest(mBeaconsFrames, 1);
+        }
+        
+        mEvents.clear();
+        for(size_t i=0; i<mAccelerations.size(); i++){
+            mEvents.push_back({mAccelerations[i].timestamp(), ACCELERATION, i});
+        }
+        for(size_t i=0; i<mAttitudes.size(); i++){
+            mEvents.push_back({mAttitudes[i].timestamp(), ATTITUDE, i});
+        }
+        for(size_t i=0; i<mBeaconsFrames.size(); i++){
+            mEvents.push_back({mBeaconsFrames[i].timestamp(), BEACONS, i});
+        }
+        for(size_t i=0; i<mLocalHeadings.size(); i++){
+            mEvents.push_back({mLocalHeadings[i].timestamp(), LOCAL_HEADING, i});
+        }
+        for(size_t i=0; i<mAltimeters.size(); i++){
+            mEvents.push_back({mAltimeters[i].timestamp(), ALTIMETER, i});
+        }
+        std::stable_sort(mEvents.begin(), mEvents.end(), [](const Event& a, const Event& b){
+            return a.timestamp < b.timestamp;
+        });
+        
+        // An attitude is superseded only by a later attitude with no other input in between,
+        // so every acceleration is applied with the attitude that preceded it.
+        mSkipsEvent.assign(mEvents.size(), false);
+        if(mParams.coalescesAttitude){
+            long lastAttitude = -1;
+            for(size_t i=0; i<mEvents.size(); i++){
+                if(mEvents[i].type!=ATTITUDE){
+                    lastAttitude = -1;
+                    continue;
+                }
+                if(0 <= lastAttitude){
+                    mSkipsEvent[lastAttitude] = true;
+                    mCounters[ATTITUDE].coalesced++;
+                }
+                lastAttitude = i;
+            }
+        }
+        
+        for(size_t k=0; k<mEvents.size(); k++){
+            if(mSkipsEvent[k]){
+                continue;
+            }
+            const Event& e = mEvents[k];
+            try{
+                switch(e.type){
+                    case ACCELERATION:
+                        mLocalizer->putAcceleration(mAccelerations[e.index]);
+                        break;
+                    case ATTITUDE:
+                        mLocalizer->putAttitude(mAttitudes[e.index]);
+                        break;
+                    case BEACONS:
+                        mLocalizer->putBeacons(mBeaconsFrames[e.index]);
+                        break;
+                    case LOCAL_HEADING:
+                        mLocalizer->putLocalHeading(mLocalHeadings[e.index]);
+                        break;
+                    case ALTIMETER:
+                        mLocalizer->putAltimeter(mAltimeters[e.index]);
+                        break;
+                }
+            }catch(...){
+                // Kept for the caller; the first error is rethrown by the next put method or flush().
+                std::lock_guard<std::mutex> errorLock(mErrorMutex);
+                if(!mError){
+                    mError = std::current_exception();
+                    mHasError.store(true, std::memory_order_release);
+                }
+            }
+            mCounters[e.type].processed++;
+        }
+    }
+    
+    void AsyncStreamLocalizer::run(){
+        while(true){
+            bool running;
+            {
+                std::unique_lock<std::mutex> lock(mWakeMutex);
+                mSleeping.store(true, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                mWakeCV.wait(lock, [this]{
+                    return !mRunning.load() || hasPending();
+                });
+                mSleeping.store(false, std::memory_order_relaxed);
+                running = mRunning.load();
+            }
+            processPending();
+            if(!running){
+                break;
+            }
+        }
+    }
+    
+}
@@ -0,0 +1,179 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef AsyncStreamLocalizer_hpp
+#define AsyncStreamLocalizer_hpp
+
+#include <stdio.h>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "bleloc.h"
+#include "StreamLocalizer.hpp"
+#include "SPSCQueue.hpp"
+
+namespace loc{
+    
+    struct AsyncSensorCounter{
+        long received = 0;  // accepted by the put method
+        long processed = 0; // passed to the wrapped localizer
+        long dropped = 0;   // beacon frames, headings and altimeter values replaced by a newer one while the queue was full
+        long coalesced = 0; // accelerations and attitudes replaced by a newer one while the queue was full, or superseded attitudes
+        size_t queueDepth = 0;
+        size_t maxQueueDepth = 0;
+    };
+    
+    struct AsyncSensorMetrics{
+        AsyncSensorCounter acceleration;
+        AsyncSensorCounter attitude;
+        AsyncSensorCounter beacons;
+        AsyncSensorCounter localHeading;
+        AsyncSensorCounter altimeter;
+    };
+    
+    /**
+     StreamLocalizer decorator that moves filter updates off the caller's thread.
+     Each put method only enqueues the input to a bounded lock-free queue of its sensor type and wakes the worker thread
+     only when it sleeps; the worker owns the wrapped localizer, drains the queues and applies the inputs in timestamp order.
+     Each put method must be called from at most one thread at a time (single producer per sensor type).
+     An input that does not fit into the full queue is kept in a latest-wins slot, which replaces the older input kept there.
+     Update callbacks are invoked on the worker thread. getStatus and resetStatus are serialized with the worker,
+     but the returned Status must only be read in the callback or after flush().
+     An exception thrown by the wrapped localizer is rethrown to the caller by the next put method or flush().
+     Pending inputs are applied before the destructor returns.
+     **/
+    class AsyncStreamLocalizer : public StreamLocalizer{
+    public:
+        using Ptr = std::shared_ptr<AsyncStreamLocalizer>;
+        
+        class Parameters{
+        public:
+            size_t queueCapacity = 256;
+            bool coalescesAttitude = true;       // apply only the latest attitude preceding each other input
+            bool dropsSupersededBeacons = true;  // apply only the latest beacon frame of each drained batch
+        };
+        
+        AsyncStreamLocalizer(std::shared_ptr<StreamLocalizer> localizer);
+        AsyncStreamLocalizer(std::shared_ptr<StreamLocalizer> localizer, Parameters params);
+        ~AsyncStreamLocalizer();
+        AsyncStreamLocalizer(const AsyncStreamLocalizer&) = delete;
+        AsyncStreamLocalizer& operator=(const AsyncStreamLocalizer&) = delete;
+        
+        AsyncStreamLocalizer& updateHandler(void (*functionCalledAfterUpdate)(Status*)) override;
+        AsyncStreamLocalizer& updateHandler(void (*functionCalledAfterUpdate)(void*, Status*), void* inUserData) override;
+        
+        AsyncStreamLocalizer& putAcceleration(const Acceleration acceleration) override;
+        AsyncStreamLocalizer& putAttitude(const Attitude attitude) override;
+        AsyncStreamLocalizer& putBeacons(const Beacons beacons) override;
+        AsyncStreamLocalizer& putLocalHeading(const LocalHeading heading) override;
+        AsyncStreamLocalizer& putAltimeter(const Altimeter altimeter) override;
+        Status* getStatus() override;
+        
+        bool resetStatus() override;
+        bool resetStatus(Pose pose) override;
+        bool resetStatus(Pose meanPose, Pose stdevPose) override;
+        bool resetStatus(Pose meanPose, Pose stdevPose, double rateContami) override;
+        bool resetStatus(const Beacons& beacons) override;
+        bool resetStatus(const Location& location, const Beacons& beacons) override;
+        
+        // Applies all pending inputs on the calling thread and returns after they have been processed.
+        // Rethrows the first exception raised by the wrapped localizer since the last call.
+        void flush();
+        
+        AsyncSensorMetrics metrics() const;
+        std::shared_ptr<StreamLocalizer> localizer() const;
+        
+    private:
+        struct Counter{
+            std::atomic<long> received{0};
+            std::atomic<long> processed{0};
+            std::atomic<long> dropped{0};
+            std::atomic<long> coalesced{0};
+            std::atomic<size_t> maxQueueDepth{0};
+        };
+        
+        enum SensorType{
+            ACCELERATION, ATTITUDE, BEACONS, LOCAL_HEADING, ALTIMETER
+        };
+        
+        struct Event{
+            long timestamp;
+            SensorType type;
+            size_t index;
+        };
+        
+        std::shared_ptr<StreamLocalizer> mLocalizer;
+        Parameters mParams;
+        
+        template<class T>
+        struct Channel{
+            Channel(size_t capacity) : queue(capacity) {}
+            SPSCQueue<T> queue;
+            SPSCLatestSlot<T> latest; // newest input that did not fit into the queue
+        };
+        
+        Channel<Acceleration> mAccelerationChannel;
+        Channel<Attitude> mAttitudeChannel;
+        Channel<Beacons> mBeaconsChannel;
+        Channel<LocalHeading> mLocalHeadingChannel;
+        Channel<Altimeter> mAltimeterChannel;
+        Counter mCounters[5];
+        
+        // buffers reused by the consumer
+        std::vector<Acceleration> mAccelerations;
+        std::vector<Attitude> mAttitudes;
+        std::vector<Beacons> mBeaconsFrames;
+        std::vector<LocalHeading> mLocalHeadings;
+        std::vector<Altimeter> mAltimeters;
+        std::vector<Event> mEvents;
+        std::vector<bool> mSkipsEvent;
+        
+        std::recursive_mutex mConsumerMutex; // held while the wrapped localizer is used
+        std::mutex mWakeMutex; // taken by the producers only to wake the sleeping worker
+        std::condition_variable mWakeCV;
+        std::atomic<bool> mSleeping{false};
+        std::atomic<bool> mRunning{true};
+        std::mutex mErrorMutex;
+        std::exception_ptr mError;
+        std::atomic<bool> mHasError{false};
+        std::thread mWorker;
+        
+        template<class T>
+        void enqueue(Channel<T>& channel, SensorType type, const T& item);
+        template<class T>
+        void drain(Channel<T>& channel, std::vector<T>& items);
+        template<class T>
+        static size_t depthOf(const Channel<T>& channel);
+        void wake();
+        bool hasPending() const;
+        void rethrowError();
+        void processPending();
+        void run();
+    };
+    
+}
+
+#endif /* AsyncStreamLocalizer_hpp */
@@ -56,7 +56,17 @@ namespace loc{
         
         localizer->updateLocationStatus(localizer->getStatus());
         
-        udb->functionCalledAfterUpdateWithPtr(userData, status);
+        if(localizer->mDefersCallbacks){
+            localizer->mDeferredStatus = status;
+            localizer->mDeferredStatusOwner.reset();
+            return;
+        }
+        if(udb->functionCalledAfterUpdateWithPtr && userData){
+            udb->functionCalledAfterUpdateWithPtr(userData, status);
+        }
+        // Prediction and filtering updates are summarized here because putBeacons returns before its own callbacks
+        // while tracking.
+        localizer->publishSummary(*status);
     }
     
     StreamLocalizer& BasicLocalizer::updateHandler(void (*functionCalledAfterUpdate)(void*, Status*), void* inUserData) {
@@ -75,6 +85,37 @@ namespace loc{
         return *this;
     }
     
+    StreamLocalizer& BasicLocalizer::summaryHandler(void (*functionCalledWithSummary)(void*, const StatusSummary&), void* inUserData) {
+        mFunctionCalledWithSummary = functionCalledWithSummary;
+        mUserDataForSummary = inUserData;
+        
+        userDataBridge.basicLocalizer = this;
+        mUserDataBridge = &userDataBridge;
+        
+        if (mLocalizer) {
+            mLocalizer->updateHandler(bridgeFunctionCalledAfterUpdate2, mUserDataBridge);
+        }
+        return *this;
+    }
+    
+    void BasicLocalizer::publishSummary(const Status& status) {
+        if (!mFunctionCalledWithSummary) {
+            return;
+        }
+        bool locationStatusChanged = status.locationStatus() != mLastSummaryLocationStatus;
+        if (0 < summaryPublishingFrequency && mHasPublishedSummary && !locationStatusChanged) {
+            double intervalMS = 1000.0/summaryPublishingFrequency;
+            long elapsedMS = status.timestamp() - mLastSummaryTimestamp;
+            if (0 <= elapsedMS && elapsedMS < intervalMS) {
+                return;
+            }
+        }
+        mHasPublishedSummary = true;
+        mLastSummaryTimestamp = status.timestamp();
+        mLastSummaryLocationStatus = status.locationStatus();
+        mFunctionCalledWithSummary(mUserDataForSummary, StatusSummary::fromStatus(status, summaryIncludesStates));
+    }
+    
     StreamLocalizer& BasicLocalizer::logHandler(void (*functionCalledToLog)(void*, std::string), void* inUserData) {
         mFunctionCalledToLog = functionCalledToLog;
         mUserDataToLog = inUserData;
@@ -149,6 +190,57 @@ namespace loc{
         return *this;
     }
     
+    StreamLocalizer& BasicLocalizer::putSensorEvents(const SensorEvents& events, const SensorBatchOptions& options) {
+        if (!isReady) {
+            return *this;
+        }
+        mLocalizer->motionPredictionMerging(options.mergesIMUSamples, options.maxMergedIntervalMS);
+        mDefersCallbacks = true;
+        try {
+            long lastCheckpoint = events.empty() ? 0 : events.front().timestamp();
+            for (const auto& event: events) {
+                putSensorEvent(event);
+                if (0 < options.checkpointIntervalMS && options.checkpointIntervalMS <= event.timestamp() - lastCheckpoint) {
+                    mLocalizer->flushMotionPrediction();
+                    dispatchDeferredUpdate();
+                    lastCheckpoint = event.timestamp();
+                }
+            }
+            mLocalizer->flushMotionPrediction();
+        } catch (...) {
+            mDefersCallbacks = false;
+            mDeferredStatus = NULL;
+            mDeferredStatusOwner.reset();
+            mLocalizer->motionPredictionMerging(false, options.maxMergedIntervalMS);
+            throw;
+        }
+        mDefersCallbacks = false;
+        dispatchDeferredUpdate();
+        mLocalizer->motionPredictionMerging(false, options.maxMergedIntervalMS);
+        return *this;
+    }
+    
+    void BasicLocalizer::dispatchDeferredUpdate() {
+        if (!mDeferredStatus) {
+            return;
+        }
+        Status* status = mDeferredStatus;
+        auto owner = mDeferredStatusOwner;
+        mDeferredStatus = NULL;
+        mDeferredStatusOwner.reset();
+        
+        bool defers = mDefersCallbacks;
+        mDefersCallbacks = false;
+        if (owner && mFunctionCalledAfterUpdate) {
+            mFunctionCalledAfterUpdate(status);
+        }
+        if (mFunctionCalledAfterUpdate2 && mUserData) {
+            mFunctionCalledAfterUpdate2(mUserData, status);
+        }
+        publishSummary(*status);
+        mDefersCallbacks = defers;
+    }
+    
     Beacons smoothBeaconsList(const std::vector<Beacon>* beacons_list , int smooth_count, int nSmooth){
         std::map<long, loc::Beacons> allBeacons;
         
@@ -281,12 +373,7 @@ namespace loc{
             double oridev;
             if(mTrackedStatus){
                 auto yaw = orientationMeter->getYaw(); // orientationMeter is always updated in putAttitude.
-                auto trackedStates = mTrackedStatus->states();
-                std::vector<double> orientations;
-                for(const auto& s: *trackedStates){
-                    orientations.push_back(s.orientationBias());
-                }
-                auto wnp = MathUtils::computeWrappedNormalParameters(orientations);
+                auto wnp = mTrackedStatus->moments()->orientationBias;
                 ori = yaw - wnp.mean();
                 oridev = wnp.stdev();
             }else{
@@ -365,12 +452,19 @@ namespace loc{
             BOOST_THROW_EXCEPTION(LocException("smoothType!=SMOOTH_LOCATION is not supported"));
         }
 
-        if (mFunctionCalledAfterUpdate) {
-            mFunctionCalledAfterUpdate(mResult.get());
-        }
-        
-        if (mFunctionCalledAfterUpdate2 && mUserData) {
-            mFunctionCalledAfterUpdate2(mUserData, mResult.get());
+        if (mDefersCallbacks) {
+            mDeferredStatus = mResult.get();
+            mDeferredStatusOwner = mResult;
+        } else {
+            if (mFunctionCalledAfterUpdate) {
+                mFunctionCalledAfterUpdate(mResult.get());
+            }
+            
+            if (mFunctionCalledAfterUpdate2 && mUserData) {
+                mFunctionCalledAfterUpdate2(mUserData, mResult.get());
+            }
+            
+            publishSummary(*mResult);
         }
         
         //if (isTrackingLocalizer() && smooth_count >= nSmooth && mState != TRACKING) {
@@ -380,12 +474,12 @@ namespace loc{
         //if (isTrackingLocalizer() && isStatesConverged && mLocationStatus!=Status::STABLE) {
         if (isTrackingLocalizer() && isStatesConverged) {
             Pose refPose = *mResult->meanPose();
-            std::vector<State> states = *mResult->states();
+            const auto& states = *mResult->states();
             int idx = Location::findClosestLocationIndex(refPose, states);
             Location locClosest = states.at(idx);
             refPose.copyLocation(locClosest);
 
-            auto std = loc::Location::standardDeviation(*mResult->states());
+            auto std = mResult->moments()->stdevLocation;
             refPose.floor(roundf(refPose.floor()));
             loc::Pose stdevPose;
             double largeOridev = 10*M_PI;
@@ -414,14 +508,14 @@ namespace loc{
         return *this;
     }
     
-    Status::LocationStatus transitLocationStatus(const Status::LocationStatus& tempLocStatus, const States& states, const LocationStatusMonitorParameters& params){
+    Status::LocationStatus transitLocationStatus(const Status::LocationStatus& tempLocStatus, const Status& status, const LocationStatusMonitorParameters& params){
 
         double std2DExitStable = params.stdev2DExitStable();
         double std2DEnterStable = params.stdev2DEnterStable();
         double std2DEnterLocating = params.stdev2DEnterLocating();
         double std2DExitLocating = params.stdev2DExitLocating();
         
-        double std2D = std::pow(Location::compute2DVariance(states), 1.0/4.0);
+        double std2D = std::pow(status.moments()->variance2D, 1.0/4.0);
         
         Status::LocationStatus newLocStatus = tempLocStatus;
         switch(tempLocStatus){
@@ -464,11 +558,12 @@ namespace loc{
             newLocStatus = midLocStatus;
         } else {
             if(this->isVerboseLocalizer){
-                double std2D = std::pow(Location::compute2DVariance(*status->states()), 1.0/4.0);
-                auto stdLoc = Location::standardDeviation(*status->states());
+                auto moments = status->moments();
+                double std2D = std::pow(moments->variance2D, 1.0/4.0);
+                const auto& stdLoc = moments->stdevLocation;
                 std::cout << "std2D=" << std2D << ",stdX="<< stdLoc.x() << ",stdY=" << stdLoc.y()  << std::endl;
             }
-            auto tmpLocStatus = transitLocationStatus(midLocStatus, *status->states(), *locationStatusMonitorParameters);
+            auto tmpLocStatus = transitLocationStatus(midLocStatus, *status, *locationStatusMonitorParameters);
             if(midLocStatus==Status::LOCATING && tmpLocStatus==Status::STABLE){
                 if(smooth_count>=nSmooth){
                     newLocStatus = Status::STABLE;
@@ -524,7 +619,7 @@ namespace loc{
     bool BasicLocalizer::resetStatus(const Location& location, const Beacons& beacons) {
         bool ret = mLocalizer->resetStatus(location, beacons);
         double meanBias = 0;
-        for(loc::State s: *mLocalizer->getStatus()->states()) {
+        for(const loc::State& s: *mLocalizer->getStatus()->states()) {
             meanBias += s.rssiBias();
         }
         mEstimatedRssiBias = meanBias / mLocalizer->getStatus()->states()->size();
@@ -653,7 +748,7 @@ namespace loc{
         deserializedModel->coeffDiffFloorStdev(coeffDiffFloorStdev);
         
         mLocalizer = std::shared_ptr<StreamParticleFilter>(new StreamParticleFilter());
-        if (mFunctionCalledAfterUpdate2 && mUserData) {
+        if ((mFunctionCalledAfterUpdate2 && mUserData) || mFunctionCalledWithSummary) {
             //mLocalizer->updateHandler(mFunctionCalledAfterUpdate2, mUserData);
             mLocalizer->updateHandler(bridgeFunctionCalledAfterUpdate2, mUserDataBridge);
         }
@@ -673,10 +768,26 @@ namespace loc{
         // Create data store
         dataStore = std::shared_ptr<DataStoreImpl> (new DataStoreImpl());
         mLocalizer->dataStore(dataStore);
+        if(particleTraceRecorder){
+            mLocalizer->particleTraceRecorder(particleTraceRecorder);
+        }
+        if(deadlineScheduler){
+            mLocalizer->deadlineScheduler(deadlineScheduler);
+        }
+        if(stationaryDetector){
+            mLocalizer->stationaryDetector(stationaryDetector);
+        }
         
         // Building - change read order to reduce memory usage peak
         //ImageHolder::setMode(ImageHolderMode(heavy));
         BuildingBuilder buildingBuilder;
+        buildingBuilder.cacheDirectory(mapCacheDir).tiled(usesTiledMaps);
+        if(usesTiledMaps){
+            // Each localizer bounds its own tiles so that setting up one does not change the budget of the others.
+            auto tileCache = std::make_shared<TileCache>();
+            tileCache->capacityBytes(mapTileCacheBytes);
+            buildingBuilder.tileCache(tileCache);
+        }
         
         auto& buildings = getArray(json, "layers");
         
@@ -692,17 +803,15 @@ namespace loc{
             CoordinateSystemParameters coordSysParams(ppmx, ppmy, ppmz, originx, originy, originz);
 
             auto& data = getString(building, "data");
-            std::ostringstream ostr;
-            ostr << floor_num << "floor.png";
-            
-            std::string path = DataUtils::stringToFile(data, workingDir, ostr.str());
+            // Decoded in memory; the image is decoded when the building is built.
+            std::string encodedImage = DataUtils::dataURIToBytes(data);
             
             int fn = floor_num;
             if (!get(param, "floor").is<picojson::null>()) {
                 fn = (int)getDouble(param, "floor");
             }
             
-            buildingBuilder.addFloorCoordinateSystemParametersAndImagePath(fn, coordSysParams, path);
+            buildingBuilder.addFloorCoordinateSystemParametersAndEncodedImage(fn, coordSysParams, std::move(encodedImage));
             
             msec = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now()-s).count();
             std::cerr << "prepare floor model[" << floor_num << "]: " << msec << "ms" << std::endl;
@@ -933,6 +1042,9 @@ namespace loc{
         statusInitializer = std::shared_ptr<StatusInitializerImpl>(new StatusInitializerImpl());
         statusInitializer->dataStore(dataStore)
         .poseProperty(poseProperty).stateProperty(stateProperty);
+        if(samplesMovableLocationsDirectly && !usesTiledMaps && dataStore->getBuilding().nFloors()>0){
+            statusInitializer->movableLocationSampler(std::make_shared<MovableLocationSampler>(dataStore->getBuilding()));
+        }
         mLocalizer->statusInitializer(statusInitializer);
         
         // Set localizer
@@ -972,6 +1084,8 @@ namespace loc{
         mixParams.rejectFloorDifference(rejectFloorDifference);
         mixParams.nBeaconsMinimum = nBeaconsMinimum;
         mLocalizer->mixtureParameters(mixParams);
+        mLocalizer->backgroundMixing(generatesMixingStatesInBackground, maxMixingProposalAgeMS);
+        mLocalizer->motionPredictionInterval(motionPredictionIntervalMS);
         
         mLocalizer->floorTransitionParameters(pfFloorTransParams);
         mLocalizer->locationStatusMonitorParameters(locationStatusMonitorParameters);
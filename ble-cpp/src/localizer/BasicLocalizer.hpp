@@ -61,6 +61,7 @@
 
 #include "SerializeUtils.hpp"
 #include "LatLngConverter.hpp"
+#include "StatusSummary.hpp"
 
 #define N_SMOOTH_MAX 10
 
@@ -137,6 +138,20 @@ namespace loc {
         void *mUserData = NULL;
         void *mUserDataToLog = NULL;
         
+        void (*mFunctionCalledWithSummary)(void*, const StatusSummary&) = NULL;
+        void *mUserDataForSummary = NULL;
+        bool mHasPublishedSummary = false;
+        long mLastSummaryTimestamp = 0;
+        Status::LocationStatus mLastSummaryLocationStatus = Status::NIL;
+        void publishSummary(const Status& status); // rate-limited by the timestamps of the statuses
+        
+        // deferral of update callbacks during putSensorEvents
+        bool mDefersCallbacks = false;
+        Status* mDeferredStatus = NULL;
+        std::shared_ptr<Status> mDeferredStatusOwner; // set when the deferred status is not owned by mLocalizer
+        void dispatchDeferredUpdate();
+        friend void bridgeFunctionCalledAfterUpdate2(void* userDataBridge, Status* status);
+        
         
         UserDataBridge userDataBridge;
         void *mUserDataBridge = NULL;
@@ -236,6 +251,9 @@ namespace loc {
         double rejectDistance = 5;
         double rejectFloorDifference = 0.99;
         int nBeaconsMinimum = 3;
+        bool generatesMixingStatesInBackground = false;
+        long maxMixingProposalAgeMS = 1500;
+        long motionPredictionIntervalMS = 0; // 0: prediction at every motion update
         
         Location locLB{0.5, 0.5, 1e-6, 1e-6};
         //Location locLB(0.5, 0.5, 0.0);
@@ -245,6 +263,13 @@ namespace loc {
         LocationStatusMonitorParameters::Ptr locationStatusMonitorParameters = std::make_shared<LocationStatusMonitorParameters>();
         
         std::shared_ptr<DataStoreImpl> dataStore;
+        ParticleTraceRecorder::Ptr particleTraceRecorder; // optional
+        DeadlineScheduler::Ptr deadlineScheduler; // optional
+        StationaryDetector::Ptr stationaryDetector; // optional
+        std::string mapCacheDir; // optional, preprocessed floor maps are cached in this directory when not empty
+        bool usesTiledMaps = false; // floor maps are loaded tile by tile on demand (requires mapCacheDir)
+        size_t mapTileCacheBytes = 256*1024*1024; // resident memory of the map tiles of this localizer
+        bool samplesMovableLocationsDirectly = true; // perturbations draw movable locations without rejection (not used with tiled maps)
         
         void normalFunction(NormalFunction type, double option);
         void meanRssiBias(double b);
@@ -295,6 +320,12 @@ namespace loc {
         StreamLocalizer& updateHandler(void (*functionCalledAfterUpdate)(void*, Status*), void* inUserData) override;
         
         StreamLocalizer& logHandler(void (*functionCalledToLog)(void*, std::string), void* inUserData);
+        
+        // Publishes a StatusSummary instead of the full Status. Summaries are rate-limited by summaryPublishingFrequency
+        // except when the location status changes.
+        StreamLocalizer& summaryHandler(void (*functionCalledWithSummary)(void*, const StatusSummary&), void* inUserData);
+        double summaryPublishingFrequency = 0.0; // [Hz] (<=0: publish at every update)
+        bool summaryIncludesStates = false;
 
         StreamLocalizer& putAttitude(const Attitude attitude) override;
         StreamLocalizer& putAcceleration(const Acceleration acceleration) override;
@@ -303,6 +334,9 @@ namespace loc {
         StreamLocalizer& putLocalHeading(const LocalHeading heading) override;
         StreamLocalizer& putHeading(const Heading heading);
         StreamLocalizer& putAltimeter(const Altimeter altimeter) override;
+        // Update handlers registered with a user data pointer and the summary handler are called only at checkpoints
+        // and at the end of the batch. Consecutive IMU samples are merged into one motion prediction.
+        StreamLocalizer& putSensorEvents(const SensorEvents& events, const SensorBatchOptions& options) override;
         Status* getStatus() override;
                                  
         bool resetStatus() override;
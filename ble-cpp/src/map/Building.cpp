@@ -22,7 +22,13 @@
 
 #include "Building.hpp"
 #include "LocException.hpp"
+#include <atomic>
 #include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <unistd.h>
 
 #include <boost/tuple/tuple_io.hpp>
 #include <boost/algorithm/minmax_element.hpp>
@@ -65,6 +71,14 @@ namespace loc{
         return floorMap;
     }
 
+    std::vector<int> Building::floorNumbers() const{
+        std::vector<int> floorNums;
+        for(const auto& pair: floors){
+            floorNums.push_back(pair.first);
+        }
+        return floorNums;
+    }
+
     bool Building::isMovable(const Location& location) const{
         int floor_int = static_cast<int>(location.floor());
         const FloorMap& floorMap = getFloorAt(floor_int);
@@ -160,6 +174,108 @@ namespace loc{
         return true;
     }
     
+    uint8_t Building::getLabel(const Location& location) const{
+        return getFloorAt(location).getLabel(location);
+    }
+    
+    uint8_t Building::getLabel(const State& state) const{
+        return getFloorAt(state).getLabel(state);
+    }
+    
+    bool Building::isMovable(const State& state) const{
+        return getLabel(state)!=label::labelWall;
+    }
+    
+    bool Building::isTransitionArea(const State& state) const{
+        uint8_t l = getLabel(state);
+        return l==label::labelEscalator || l==label::labelElevator || l==label::labelStairs;
+    }
+    
+    bool Building::checkMovableRoute(const State& start, const State& end) const{
+        uint8_t labelEnd = getLabel(end);
+        if(labelEnd==label::labelWall){
+            return false;
+        }
+        uint8_t labelStart = getLabel(start);
+        // Do not allow to move from escalater_end to escalator
+        if(labelStart==label::labelEscalatorEnd && labelEnd==label::labelEscalator){
+            return false;
+        }
+        if(start.floor()!=end.floor()){
+            return false;
+        }
+        const FloorMap& floorMap = getFloorAt(start);
+        return floorMap.wallCrossingRatio(start, end, labelStart) >= 1.0;
+    }
+    
+    template<class Tlocation>
+    void Building::getLabels(const Tlocation* locations, size_t n, uint8_t* labels) const{
+        const FloorMap* floorMap = nullptr;
+        int floorCurrent = 0;
+        for(size_t i=0; i<n; i++){
+            int floor_int = static_cast<int>(locations[i].floor());
+            if(floorMap==nullptr || floor_int!=floorCurrent){
+                floorMap = &getFloorAt(floor_int);
+                floorCurrent = floor_int;
+            }
+            labels[i] = floorMap->getLabel(locations[i]);
+        }
+    }
+    
+    template<class Tlocation>
+    void Building::checkCrossingWalls(const Tlocation* starts, const Tlocation* ends, size_t n, bool* crosses) const{
+        const FloorMap* floorMap = nullptr;
+        int floorCurrent = 0;
+        for(size_t i=0; i<n; i++){
+            if(starts[i].floor()!=ends[i].floor()){
+                crosses[i] = true;
+                continue;
+            }
+            int floor_int = static_cast<int>(starts[i].floor());
+            if(floorMap==nullptr || floor_int!=floorCurrent){
+                floorMap = &getFloorAt(floor_int);
+                floorCurrent = floor_int;
+            }
+            crosses[i] = floorMap->checkCrossingWall(starts[i], ends[i]);
+        }
+    }
+    
+    template<class Tlocation>
+    void Building::checkMovableRoutes(const Tlocation* starts, const Tlocation* ends, size_t n, bool* movables) const{
+        const FloorMap* floorMap = nullptr;
+        int floorCurrent = 0;
+        for(size_t i=0; i<n; i++){
+            int floor_int = static_cast<int>(ends[i].floor());
+            if(floorMap==nullptr || floor_int!=floorCurrent){
+                floorMap = &getFloorAt(floor_int);
+                floorCurrent = floor_int;
+            }
+            uint8_t labelEnd = floorMap->getLabel(ends[i]);
+            if(labelEnd==label::labelWall){
+                movables[i] = false;
+                continue;
+            }
+            if(starts[i].floor()!=ends[i].floor()){
+                movables[i] = false;
+                continue;
+            }
+            uint8_t labelStart = floorMap->getLabel(starts[i]);
+            // Do not allow to move from escalater_end to escalator
+            if(labelEnd==label::labelEscalator && labelStart==label::labelEscalatorEnd){
+                movables[i] = false;
+                continue;
+            }
+            movables[i] = floorMap->wallCrossingRatio(starts[i], ends[i], labelStart) >= 1.0;
+        }
+    }
+    
+    template void Building::getLabels<Location>(const Location*, size_t, uint8_t*) const;
+    template void Building::getLabels<State>(const State*, size_t, uint8_t*) const;
+    template void Building::checkCrossingWalls<Location>(const Location*, const Location*, size_t, bool*) const;
+    template void Building::checkCrossingWalls<State>(const State*, const State*, size_t, bool*) const;
+    template void Building::checkMovableRoutes<Location>(const Location*, const Location*, size_t, bool*) const;
+    template void Building::checkMovableRoutes<State>(const State*, const State*, size_t, bool*) const;
+    
     int Building::minFloor() const{
         return minFloor_;
     }
@@ -196,24 +312,164 @@ namespace loc{
         
         mFloorCoordinateSystemParametersMap[floor_num] = coordinateSystemParameters;
         mFloorImagePathMap[floor_num] = imagePath;
+        mFloorEncodedImageMap.erase(floor_num);
+        return *this;
+    }
+    
+    BuildingBuilder& BuildingBuilder::addFloorCoordinateSystemParametersAndEncodedImage(int floor_num, CoordinateSystemParameters coordinateSystemParameters, std::string encodedImage){
+        mFloorCoordinateSystemParametersMap[floor_num] = coordinateSystemParameters;
+        mFloorEncodedImageMap[floor_num] = std::move(encodedImage);
+        mFloorImagePathMap.erase(floor_num);
+        return *this;
+    }
+    
+    BuildingBuilder& BuildingBuilder::cacheDirectory(const std::string& dir){
+        mCacheDirectory = dir;
+        return *this;
+    }
+    
+    BuildingBuilder& BuildingBuilder::tiled(bool tiled){
+        mTiled = tiled;
+        return *this;
+    }
+    
+    BuildingBuilder& BuildingBuilder::tileCache(TileCache::Ptr cache){
+        mTileCache = cache;
+        return *this;
+    }
+    
+    BuildingBuilder& BuildingBuilder::nThreads(int n){
+        mNThreads = n;
         return *this;
     }
     
+    // FNV-1a
+    static uint64_t hashBytes(const std::string& bytes){
+        uint64_t h = 14695981039346656037ULL;
+        for(unsigned char c: bytes){
+            h ^= c;
+            h *= 1099511628211ULL;
+        }
+        return h;
+    }
+    
+    // Temporary file next to path, unique among processes and threads sharing the cache directory
+    static std::string temporaryPathOf(const std::string& path){
+        static std::atomic<unsigned long> nTemporaryFiles(0);
+        std::ostringstream ss;
+        ss << path << ".tmp" << getpid() << "-" << nTemporaryFiles++;
+        return ss.str();
+    }
+    
+    FloorMap BuildingBuilder::buildFloor(int floor_num) const{
+        std::string name = std::to_string(floor_num);
+        CoordinateSystem coordSys(mFloorCoordinateSystemParametersMap.at(floor_num));
+        
+        if(mFloorImagePathMap.count(floor_num)){
+            ImageHolder image(mFloorImagePathMap.at(floor_num), name);
+            return FloorMap(image, coordSys);
+        }
+        
+        const std::string& encoded = mFloorEncodedImageMap.at(floor_num);
+        std::string cachePath;
+        if(!mCacheDirectory.empty()){
+            std::ostringstream ss;
+            ss << mCacheDirectory << "/floormap-" << std::hex << hashBytes(encoded) << "-" << std::dec << encoded.size();
+            cachePath = ss.str();
+        }
+        
+        if(mTiled){
+            if(cachePath.empty()){
+                BOOST_THROW_EXCEPTION(LocException("Tiled floor maps require a cache directory."));
+            }
+            std::string tilesPath = cachePath + ".tiles";
+            try{
+                return FloorMap(ImageHolder::openTiles(tilesPath, name, mTileCache), coordSys);
+            }catch(LocException& e){
+                // Not converted yet
+            }
+            std::string tmpPath = temporaryPathOf(tilesPath);
+            try{
+                ImageHolder::decode(encoded, name).writeTiles(tmpPath, TiledLabelStore::defaultTileSize, FloorMap::transitionAreaColors());
+            }catch(LocException& e){
+                std::remove(tmpPath.c_str());
+                throw;
+            }
+            if(std::rename(tmpPath.c_str(), tilesPath.c_str())!=0){
+                std::remove(tmpPath.c_str());
+                BOOST_THROW_EXCEPTION(LocException("Failed to write " + tilesPath));
+            }
+            return FloorMap(ImageHolder::openTiles(tilesPath, name, mTileCache), coordSys);
+        }
+        
+        if(!cachePath.empty()){
+            cachePath += ".bin";
+            std::ifstream ifs(cachePath, std::ios::binary);
+            if(ifs){
+                try{
+                    ImageHolder image = ImageHolder::readLabels(ifs, name);
+                    auto engine = std::make_shared<WallQueryEngine>(image, ifs);
+                    return FloorMap(image, coordSys, engine);
+                }catch(LocException& e){
+                    std::cerr << "Ignored the map cache at " << cachePath << std::endl;
+                }
+            }
+        }
+        
+        ImageHolder image = ImageHolder::decode(encoded, name);
+        FloorMap floorMap(image, coordSys);
+        if(!cachePath.empty()){
+            // Written to a temporary file first so that a partially written cache is never read.
+            std::string tmpPath = temporaryPathOf(cachePath);
+            std::ofstream ofs(tmpPath, std::ios::binary);
+            if(ofs){
+                image.writeLabels(ofs);
+                floorMap.wallQueryEngine()->writeFields(ofs);
+                ofs.close();
+                if(!ofs || std::rename(tmpPath.c_str(), cachePath.c_str())!=0){
+                    std::remove(tmpPath.c_str());
+                }
+            }
+        }
+        return floorMap;
+    }
+    
     Building BuildingBuilder::build(){
+        std::vector<int> floorNums;
+        for(const auto& pair: mFloorCoordinateSystemParametersMap){
+            floorNums.push_back(pair.first);
+        }
+        size_t n = floorNums.size();
+        std::vector<FloorMap> floorMaps(n);
+        std::vector<std::exception_ptr> errors(n);
+        
+        std::atomic<size_t> next(0);
+        auto work = [&](){
+            for(size_t i = next++; i<n; i = next++){
+                try{
+                    floorMaps[i] = buildFloor(floorNums[i]);
+                }catch(...){
+                    errors[i] = std::current_exception();
+                }
+            }
+        };
+        size_t nThreads = mNThreads>0 ? mNThreads : std::max(1u, std::min<unsigned>(defaultNThreads, std::thread::hardware_concurrency()));
+        nThreads = std::min(nThreads, n);
+        std::vector<std::thread> threads;
+        for(size_t t=1; t<nThreads; t++){
+            threads.emplace_back(work);
+        }
+        work();
+        for(auto& th: threads){
+            th.join();
+        }
+        
         std::map<int, FloorMap> floorsMap;
-        for(auto iter= mFloorCoordinateSystemParametersMap.begin();
-            iter!=mFloorCoordinateSystemParametersMap.end();
-            iter++){
-            
-            int floor_num = iter->first;
-            std::string name = std::to_string(floor_num);
-            CoordinateSystemParameters coordSysParams = mFloorCoordinateSystemParametersMap[floor_num];
-            std::string path = mFloorImagePathMap[floor_num];
-            
-            ImageHolder image(path,name);
-            CoordinateSystem coordSys(coordSysParams);
-            FloorMap floorMap(image, coordSys);
-            floorsMap[floor_num] = floorMap;
+        for(size_t i=0; i<n; i++){
+            if(errors[i]){
+                std::rethrow_exception(errors[i]);
+            }
+            floorsMap[floorNums[i]] = floorMaps[i];
         }
         
         Building building(floorsMap);
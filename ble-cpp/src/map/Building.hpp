@@ -48,6 +48,7 @@ namespace loc {
         const FloorMap& getFloorAt(int floor_num) const;
         const FloorMap& getFloorAt(const Location& location) const;
         size_t nFloors() const { return this->floors.size(); }
+        std::vector<int> floorNumbers() const;
 
         bool isMovable(const Location& location) const;
         bool isValid(const Location& location) const;
@@ -63,6 +64,18 @@ namespace loc {
         bool checkCrossingWall(const Location& start, const Location& end) const;
         bool checkMovableRoute(const Location& start, const Location& end) const;
         
+        uint8_t getLabel(const Location& location) const;
+        // Overloads for particles reuse the map label cached in the state while it stays on the same pixel.
+        uint8_t getLabel(const State& state) const;
+        bool isMovable(const State& state) const;
+        bool isTransitionArea(const State& state) const;
+        bool checkMovableRoute(const State& start, const State& end) const;
+        // Batched queries over n locations (Tlocation: Location or State) written to the output arrays of n elements.
+        // The floor map is looked up once per run of locations on the same floor, and each location is transformed once.
+        template<class Tlocation> void getLabels(const Tlocation* locations, size_t n, uint8_t* labels) const;
+        template<class Tlocation> void checkCrossingWalls(const Tlocation* starts, const Tlocation* ends, size_t n, bool* crosses) const;
+        template<class Tlocation> void checkMovableRoutes(const Tlocation* starts, const Tlocation* ends, size_t n, bool* movables) const;
+        
         int minFloor() const;
         int maxFloor() const;
         bool isValidFloor(int floor);
@@ -74,8 +87,28 @@ namespace loc {
     private:
         std::map<int, CoordinateSystemParameters> mFloorCoordinateSystemParametersMap;
         std::map<int, std::string> mFloorImagePathMap;
+        std::map<int, std::string> mFloorEncodedImageMap;
+        std::string mCacheDirectory;
+        bool mTiled = false;
+        TileCache::Ptr mTileCache;
+        int mNThreads = 0;
+        // Each floor being prepared holds its decoded image, so the default concurrency is kept small to bound peak memory.
+        static constexpr int defaultNThreads = 2;
+        
+        FloorMap buildFloor(int floor_num) const;
+        
     public:
         BuildingBuilder& addFloorCoordinateSystemParametersAndImagePath(int floor_num, CoordinateSystemParameters coordinateSystemParameters, std::string imagePath);
+        // encodedImage: bytes of an image file (e.g. PNG) decoded in memory
+        BuildingBuilder& addFloorCoordinateSystemParametersAndEncodedImage(int floor_num, CoordinateSystemParameters coordinateSystemParameters, std::string encodedImage);
+        // Preprocessed floor maps of encoded images are cached in the directory when set. Failures to write the cache are ignored.
+        BuildingBuilder& cacheDirectory(const std::string& dir);
+        // Floors of encoded images are converted to tiled files in the cache directory and loaded on demand.
+        // Tile memory is bounded by the tile cache (TileCache::shared() when not set).
+        BuildingBuilder& tiled(bool tiled);
+        BuildingBuilder& tileCache(TileCache::Ptr cache);
+        // The number of floors prepared concurrently. 0 uses up to 2 hardware threads.
+        BuildingBuilder& nThreads(int n);
         Building build();
     };
 }
@@ -42,10 +42,23 @@ namespace loc{
     FloorMap::FloorMap(ImageHolder image, CoordinateSystem coordSys){
         mImage = image;
         mCoordSys = coordSys;
-        
-        //for(const Color&c : colorTransitionArea){
-        //    mImage.setUpIndexForColor(c);
-        //}
+        // Walls are static, so the clearance field is computed once when the map is loaded.
+        // Full-size derived rasters are not built for tiled images so that only the accessed tiles are resident.
+        // Their nearest-site raster of transition areas is stored in the tiled file.
+        if(!mImage.isTiled()){
+            mWallQueryEngine = std::make_shared<WallQueryEngine>(mImage);
+            // Closest transition area pixels are looked up from a raster instead of searching a kd-tree per query.
+            mImage.setUpNearestSiteRaster(colorTransitionArea);
+        }
+    }
+    
+    FloorMap::FloorMap(ImageHolder image, CoordinateSystem coordSys, WallQueryEngine::Ptr wallQueryEngine){
+        mImage = image;
+        mCoordSys = coordSys;
+        mWallQueryEngine = wallQueryEngine;
+        if(!mImage.isTiled()){
+            mImage.setUpNearestSiteRaster(colorTransitionArea);
+        }
     }
 
     Color FloorMap::getColor(const Location& location) const{
@@ -91,7 +104,7 @@ namespace loc{
     }
 
     bool FloorMap::isFloor(const Location &location) const{
-        return checkColor(location, color::colorFloor);
+        return checkLabel(location, label::labelFloor);
     }
     
     bool FloorMap::isValid(const Location& location) const{
@@ -118,28 +131,59 @@ namespace loc{
         Color pixelColor = getColor(location);
         return pixelColor.equals(color);
     }
+    
+    uint8_t FloorMap::getLabel(const Location& location) const{
+        Location localCoord = mCoordSys.worldToLocalState(location);
+        return mImage.getLabel(getY(localCoord), getX(localCoord));
+    }
+    
+    uint8_t FloorMap::getLabel(const State& state) const{
+        Location localCoord = mCoordSys.worldToLocalState(static_cast<const Location&>(state));
+        int x = getX(localCoord);
+        int y = getY(localCoord);
+        int rows = mImage.rows();
+        int cols = mImage.cols();
+        // Pixels outside the image share one index because they have the same label.
+        int32_t pixel = (0<=x && x<cols && 0<=y && y<rows) ? y*cols + x : rows*cols;
+        int floor = static_cast<int>(state.floor());
+        uint8_t l;
+        if(state.cachedMapLabel(floor, pixel, l)){
+            return l;
+        }
+        l = mImage.getLabel(y, x);
+        state.cacheMapLabel(floor, pixel, l);
+        return l;
+    }
+    
+    bool FloorMap::checkLabel(const Location& location, uint8_t l) const{
+        return getLabel(location) == l;
+    }
 
     bool FloorMap::isWall(const Location& location) const{
-        return checkColor(location, color::colorWall);
+        return checkLabel(location, label::labelWall);
     }
 
     bool FloorMap::isStairs(const Location& location) const {
-        return checkColor(location, color::colorStairs);
+        return checkLabel(location, label::labelStairs);
     }
 
     bool FloorMap::isElevator(const Location& location) const{
-        return checkColor(location, color::colorElevator);
+        return checkLabel(location, label::labelElevator);
     }
 
     bool FloorMap::isEscalator(const Location& location) const{
-        return checkColor(location, color::colorEscalator);
+        return checkLabel(location, label::labelEscalator);
     }
     
     bool FloorMap::isEscalatorEnd(const Location& location) const{
-        return checkColor(location, color::colorEscalatorEnd);
+        return checkLabel(location, label::labelEscalatorEnd);
     }
 
     double FloorMap::wallCrossingRatio(const Location& start, const Location& end) const{
+        return wallCrossingRatio(start, end, getLabel(start));
+    }
+    
+    double FloorMap::wallCrossingRatio(const Location& start, const Location& end, uint8_t labelStart) const{
         Location startLocal = mCoordSys.worldToLocalState(start);
         double x0 = (startLocal.x());
         double y0 = (startLocal.y());
@@ -147,6 +191,10 @@ namespace loc{
         Location endLocal = mCoordSys.worldToLocalState(end);
         double x1 = (endLocal.x());
         double y1 = (endLocal.y());
+        
+        if(mWallQueryEngine){
+            return mWallQueryEngine->wallCrossingRatio(x0, y0, x1, y1, labelStart==label::labelEscalatorEnd);
+        }
 
         double norm = sqrt(pow(x1-x0,2)+pow(y1-y0,2));
 
@@ -158,23 +206,18 @@ namespace loc{
         double x = x0;
         double y = y0;
         
-        bool startIsEscEnd = isEscalatorEnd(start);
+        bool startIsEscEnd = labelStart==label::labelEscalatorEnd;
 
         int count=0;
         while(count<=norm_int){
             int yInt = doubleToImageCoordinate(y);
             int xInt = doubleToImageCoordinate(x);
-            Color c = color::colorFloor;
-            bool pixelIsValid = mImage.checkValid(yInt, xInt);
-            if(pixelIsValid){
-                c = mImage.get(yInt, xInt);
-            }else{
-                c = color::colorFloor;
-            }
-            if(c.equals(color::colorWall)){
+            // Pixels outside the image are labeled as floor.
+            uint8_t l = mImage.getLabel(yInt, xInt);
+            if(l == label::labelWall){
                 return ((double)count-1)/norm_int;
             }
-            if(startIsEscEnd && c.equals(color::colorEscalator)){
+            if(startIsEscEnd && l == label::labelEscalator){
                 return ((double)count-1)/norm_int;
             }
             x+=dx;
@@ -189,6 +232,26 @@ namespace loc{
         return ratio < 1.0;
     }
     
+    std::vector<double> FloorMap::wallCrossingRatios(const std::vector<Location>& starts, const std::vector<Location>& ends) const{
+        if(starts.size()!=ends.size()){
+            BOOST_THROW_EXCEPTION(LocException("starts.size() != ends.size()"));
+        }
+        std::vector<double> ratios(starts.size());
+        for(size_t i=0; i<starts.size(); i++){
+            ratios[i] = wallCrossingRatio(starts[i], ends[i]);
+        }
+        return ratios;
+    }
+    
+    std::vector<bool> FloorMap::checkCrossingWalls(const std::vector<Location>& starts, const std::vector<Location>& ends) const{
+        std::vector<double> ratios = wallCrossingRatios(starts, ends);
+        std::vector<bool> crosses(ratios.size());
+        for(size_t i=0; i<ratios.size(); i++){
+            crosses[i] = ratios[i] < 1.0;
+        }
+        return crosses;
+    }
+    
     double FloorMap::estimateWallAngle(const Location &start, const Location& end) const{
         
         double r = wallCrossingRatio(start, end);
@@ -204,6 +267,34 @@ namespace loc{
         nearWall.x(x);
         nearWall.y(y);
         
+        // Slide along the wall tangent looked up from the normal field, and fall back to the ray sweep when the tangent is blocked.
+        if(mWallQueryEngine){
+            Location nearWallLocal = mCoordSys.worldToLocalState(nearWall);
+            double nx, ny;
+            if(mWallQueryEngine->wallNormal(getY(nearWallLocal), getX(nearWallLocal), nx, ny)){
+                // Transform the normal (a gradient) from pixel to world coordinates.
+                Location origin(nearWall), unit(nearWall);
+                origin.x(0).y(0);
+                unit.x(1).y(1);
+                Location originLocal = mCoordSys.worldToLocalState(origin);
+                Location unitLocal = mCoordSys.worldToLocalState(unit);
+                double nxWorld = nx*(unitLocal.x() - originLocal.x());
+                double nyWorld = ny*(unitLocal.y() - originLocal.y());
+                double tx = -nyWorld;
+                double ty = nxWorld;
+                if(tx*dx + ty*dy < 0){
+                    tx = -tx;
+                    ty = -ty;
+                }
+                double tangentAngle = std::atan2(ty, tx);
+                nearWall2.x(x + std::cos(tangentAngle) * norm);
+                nearWall2.y(y + std::sin(tangentAngle) * norm);
+                if(wallCrossingRatio(nearWall, nearWall2) >= 1.0){
+                    return Pose::normalizeOrientaion(tangentAngle);
+                }
+            }
+        }
+        
         int sign = 1;
         for(double angle = 1; angle<=90; angle++){
             for(int i=0; i<2; i++){
@@ -229,35 +320,37 @@ namespace loc{
         return mCoordSys;
     }
     
+    const ImageHolder& FloorMap::image() const{
+        return mImage;
+    }
+    
+    WallQueryEngine::Ptr FloorMap::wallQueryEngine() const{
+        return mWallQueryEngine;
+    }
+    
     bool FloorMap::isTransitionArea(const Location& location) const{
-        if(isEscalator(location) || isElevator(location) || isStairs(location)){
+        uint8_t l = getLabel(location);
+        if(l == label::labelEscalator || l == label::labelElevator || l == label::labelStairs){
             return true;
         }else{
             return false;
         }
     }
     
+    const std::vector<Color>& FloorMap::transitionAreaColors(){
+        return colorTransitionArea;
+    }
+    
     std::vector<Location> FloorMap::findClosestTransitionAreaLocations(const Location& location) const{
         Location localCoord = mCoordSys.worldToLocalState(location);
         ImageHolder::Point pIm = getPoint(location);
-        ImageHolder::Point pClosest;
-        
-        double dmin = std::numeric_limits<double>::max();
-        for(auto& c: colorTransitionArea){
-            auto psRet = mImage.findClosestPoints(c, pIm);
-            if(psRet.size()==0) continue;
         
-            auto pRet = psRet.at(0);
-            double dist = ImageHolder::Point::distance(pIm, pRet);
-            if(dist < dmin){
-                dmin = dist;
-                pClosest = pRet;
-            }
-        }
         std::vector<Location> locsRet;
-        if(std::numeric_limits<double>::max()<=dmin){
+        auto psRet = mImage.findClosestPoint(colorTransitionArea, pIm);
+        if(psRet.size()==0){
             return locsRet;
         }
+        ImageHolder::Point pClosest = psRet.at(0);
         
         localCoord.x(pClosest.x);
         localCoord.y(pClosest.y);
@@ -27,16 +27,31 @@
 
 #include "CoordinateSystem.hpp"
 #include "ImageHolder.hpp"
+#include "WallQueryEngine.hpp"
 #include "State.hpp"
 
 namespace loc{
+    
+    // Labels of the areas in floor maps
+    namespace label{
+        constexpr uint8_t labelFloor = white;
+        constexpr uint8_t labelWall = black;
+        constexpr uint8_t labelStairs = blue;
+        constexpr uint8_t labelElevator = yellow;
+        constexpr uint8_t labelEscalator = lime;
+        
+        constexpr uint8_t labelEscalatorEnd = green;
+    }
+    
     class FloorMap{
     protected:
         CoordinateSystem mCoordSys;
         ImageHolder mImage;
+        WallQueryEngine::Ptr mWallQueryEngine;
 
         Color getColor(const Location& location) const;
         bool checkColor(const Location& location, const Color& color) const;
+        bool checkLabel(const Location& location, uint8_t label) const;
         int getX(const Location& location) const;
         int getY(const Location& location) const;
         ImageHolder::Point getPoint(const Location& location) const;
@@ -46,7 +61,13 @@ namespace loc{
         FloorMap() = default;
         ~FloorMap() = default;
         FloorMap(ImageHolder image, CoordinateSystem coordSys);
+        // Uses precomputed wall fields (e.g. restored from a cache) of the image.
+        FloorMap(ImageHolder image, CoordinateSystem coordSys, WallQueryEngine::Ptr wallQueryEngine);
 
+        // Label of the pixel at the location. Locations outside the image are labeled as floor.
+        uint8_t getLabel(const Location& location) const;
+        // Reuses the label cached in the state while the state stays on the same pixel.
+        uint8_t getLabel(const State& state) const;
         bool isMovable(const Location& location) const;
         bool isValid(const Location& location) const;
         bool isFloor(const Location& location) const;
@@ -59,14 +80,23 @@ namespace loc{
         bool checkMovable(const Location& start, const Location& end) const;
 
         double wallCrossingRatio(const Location& start, const Location& end) const;
+        // labelStart: label at start
+        double wallCrossingRatio(const Location& start, const Location& end, uint8_t labelStart) const;
         bool checkCrossingWall(const Location& start, const Location& end) const;
+        // Batched versions for segments from starts[i] to ends[i]
+        std::vector<double> wallCrossingRatios(const std::vector<Location>& starts, const std::vector<Location>& ends) const;
+        std::vector<bool> checkCrossingWalls(const std::vector<Location>& starts, const std::vector<Location>& ends) const;
 
         double estimateWallAngle(const Location&start, const Location& end) const;
         
         const CoordinateSystem& coordinateSystem() const;
+        const ImageHolder& image() const;
+        WallQueryEngine::Ptr wallQueryEngine() const;
         
         bool isTransitionArea(const Location& location) const;
         std::vector<Location> findClosestTransitionAreaLocations(const Location& location) const;
+        // Colors of stairs, elevators and escalators. Tiled images store their nearest-site raster (see ImageHolder::writeTiles).
+        static const std::vector<Color>& transitionAreaColors();
         
     protected:
         bool isInsideFloor(const Location& location) const;
@@ -24,7 +24,12 @@
 #include <boost/bimap.hpp>
 #include "ImageHolder.hpp"
 #include "LocException.hpp"
+#include "NearestSiteRaster.hpp"
 #include <opencv2/flann/flann.hpp>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
 
 namespace loc{
     
@@ -38,7 +43,11 @@ namespace loc{
         return dist;
     }
     
+#ifdef IMAGE_HOLDER_DENSE
+    ImageHolderMode ImageHolder::mode_ = dense;
+#else
     ImageHolderMode ImageHolder::mode_ = light;
+#endif
     bool ImageHolder::precomputesIndex = false;
     
     Color::Color(uint8_t r, uint8_t g, uint8_t b){
@@ -101,6 +110,21 @@ namespace loc{
         return this->rgbcode() < right.rgbcode();
     }
     
+    uint8_t ImageHolder::colorToLabel(const Color& c){
+        for(int i=0; i<colorList.size(); i++){
+            if(c.equals(colorList.at(i))){
+                return i;
+            }
+        }
+        return label::unknown;
+    }
+    
+    // Pixels of colors outside the color list are read as white in every mode.
+    static uint8_t pixelLabel(const Color& c){
+        uint8_t l = ImageHolder::colorToLabel(c);
+        return l==label::unknown ? label::white : l;
+    }
+    
     bool ImageHolder::checkValid(int y, int x) const
     {
         if(0<=y && y<rows() && 0<=x && x<cols()){
@@ -121,13 +145,47 @@ namespace loc{
         ~IndexWrapper(){};
     };
     
+    static cv::Mat readImage(const std::string& filepath){
+        cv::Mat image = cv::imread(filepath);
+        if(image.empty()){
+            LocException ex("Failed to read the image file at " + filepath);
+            BOOST_THROW_EXCEPTION(ex);
+        }
+        return image;
+    }
+    
+    static void checkImageType(const cv::Mat& image){
+        if(image.empty() || image.type()!=CV_8UC3){
+            BOOST_THROW_EXCEPTION(LocException("An 8-bit 3-channel image is required."));
+        }
+    }
+    
+    static uint32_t labelMaskOf(const std::vector<Color>& colors){
+        uint32_t mask = 0;
+        for(const Color& c: colors){
+            uint8_t l = ImageHolder::colorToLabel(c);
+            if(l==label::unknown){
+                BOOST_THROW_EXCEPTION(LocException("The color does not have a label."));
+            }
+            mask |= 1u << l;
+        }
+        return mask;
+    }
+    
     class ImageHolder::Impl{
     protected:
         mutable std::mutex mtx_;
-        std::map<Color, ImageHolder::Points> mColorPointsMap;
+        mutable std::map<Color, ImageHolder::Points> mColorPointsMap;
         
         mutable std::map<Color, std::shared_ptr<IndexWrapper>> mColorIndexMap;
-        std::map<Color, cv::Mat> mColorDataMap;
+        mutable std::map<Color, cv::Mat> mColorDataMap;
+        
+        // Keyed by the bit mask of labels. Written only by setUpNearestSiteRaster.
+        std::map<uint32_t, NearestSiteRaster::Ptr> mSiteRasters;
+        
+        static uint32_t labelMask(const std::vector<Color>& colors){
+            return labelMaskOf(colors);
+        }
         
     public:
         virtual ~Impl() = default;
@@ -136,14 +194,29 @@ namespace loc{
         virtual Color get(int y, int x) const = 0;
         virtual std::vector<Point> getPoints(const Color& c) const = 0;
         
+        virtual uint8_t getLabel(int y, int x) const{
+            if(0<=y && y<rows() && 0<=x && x<cols()){
+                return pixelLabel(get(y, x));
+            }
+            return label::white;
+        }
+        
         virtual void setUpIndices(){
             for(const Color& c: colorsToIndices){
                 this->setUpIndexForColor(c);
             }
         }
         
+        virtual bool isTiled() const{
+            return false;
+        }
+        
         virtual void setUpIndexForColor(const Color& c){
             std::lock_guard<std::mutex> lock(mtx_);
+            setUpIndexForColorLocked(c);
+        }
+        
+        void setUpIndexForColorLocked(const Color& c) const{
             if(mColorPointsMap.count(c)==0){
                 auto points = getPoints(c);
                 int n = static_cast<int>(points.size());
@@ -162,13 +235,64 @@ namespace loc{
             }
         }
         
+        virtual void setUpNearestSiteRaster(const std::vector<Color>& colors){
+            uint32_t mask = labelMask(colors);
+            if(mSiteRasters.count(mask)==0){
+                mSiteRasters[mask] = std::make_shared<NearestSiteRaster>(rows(), cols(), [&](int y, int x){
+                    uint8_t l = getLabel(y, x);
+                    return l!=label::unknown && (mask & (1u << l))!=0;
+                });
+            }
+        }
+        
+        virtual Points findClosestPoint(const std::vector<Color>& colors, const ImageHolder::Point& p) const{
+            uint32_t mask = labelMask(colors);
+            auto iter = mSiteRasters.find(mask);
+            if(iter!=mSiteRasters.end()){
+                Points psRet;
+                int ySite, xSite;
+                if(iter->second->nearest(p.y, p.x, ySite, xSite)){
+                    psRet.push_back(Point(xSite, ySite));
+                }
+                return psRet;
+            }
+            // Falls back to the per-color indices.
+            Points psRet;
+            double dmin = std::numeric_limits<double>::max();
+            for(const Color& c: colors){
+                auto ps = findClosestPoints(c, p);
+                if(ps.size()==0) continue;
+                double dist = ImageHolder::Point::distance(p, ps.at(0));
+                if(dist < dmin){
+                    dmin = dist;
+                    psRet = Points{ps.at(0)};
+                }
+            }
+            return psRet;
+        }
+        
         virtual Points findClosestPoints(const Color& c, const ImageHolder::Point& p, int k = 1) const{
+            if(k==1){
+                auto iter = mSiteRasters.find(labelMask({c}));
+                if(iter!=mSiteRasters.end()){
+                    Points psRet;
+                    int ySite, xSite;
+                    if(iter->second->nearest(p.y, p.x, ySite, xSite)){
+                        psRet.push_back(Point(xSite, ySite));
+                    }
+                    return psRet;
+                }
+            }
             
             std::lock_guard<std::mutex> lock(mtx_);
             
             if(mColorPointsMap.count(c)==0){
-                LocException ex("Index is not set for the input color");
-                BOOST_THROW_EXCEPTION(ex);
+                // Tiled images do not scan all the pixels when they are opened.
+                if(!isTiled()){
+                    LocException ex("Index is not set for the input color");
+                    BOOST_THROW_EXCEPTION(ex);
+                }
+                setUpIndexForColorLocked(c);
             }
             
             const Points& points = mColorPointsMap.at(c);
@@ -212,12 +336,28 @@ namespace loc{
         
     public:
         ImplHeavy(){}
-        ImplHeavy(const std::string& filepath, const std::string& name){
+        ImplHeavy(const std::string& filepath, const std::string& name) : ImplHeavy(readImage(filepath), name){}
+        ImplHeavy(const cv::Mat& image, const std::string& name){
+            checkImageType(image);
             name_ = name;
-            mat_ = cv::imread(filepath);
-            if(mat_.empty()){
-                LocException ex("Failed to read the image file at " + filepath);
-                BOOST_THROW_EXCEPTION(ex);
+            mat_ = image;
+            
+            // Pixels of colors outside the color list are replaced with white so that get, getLabel and getPoints agree.
+            bool copied = false;
+            for(int y=0; y<mat_.rows; y++){
+                for(int x=0; x<mat_.cols; x++){
+                    cv::Vec3b vec = mat_.at<cv::Vec3b>(y, x);
+                    if(ImageHolder::colorToLabel(Color(vec[2], vec[1], vec[0]))==label::unknown){
+                        if(!copied){
+                            mat_ = image.clone();
+                            copied = true;
+                        }
+                        cv::Vec3b& pixel = mat_.at<cv::Vec3b>(y, x);
+                        pixel[0] = color::white.b_;
+                        pixel[1] = color::white.g_;
+                        pixel[2] = color::white.r_;
+                    }
+                }
             }
             
             this->setUpIndices();
@@ -228,7 +368,7 @@ namespace loc{
             return mat_.rows;
         }
         int cols() const{
-            return mat_.rows;
+            return mat_.cols;
         }
         Color get(int y, int x) const{
             cv::Vec3b vec = mat_.at<cv::Vec3b>(y, x);
@@ -268,7 +408,9 @@ namespace loc{
             }
         }
         
-        ImplLight(const std::string& filepath, const std::string& name) : ImplLight(){
+        ImplLight(const std::string& filepath, const std::string& name) : ImplLight(readImage(filepath), name){}
+        ImplLight(const cv::Mat& image, const std::string& name) : ImplLight(){
+            checkImageType(image);
             
             typedef Eigen::Triplet<uint8_t> Triplet;
             
@@ -276,7 +418,6 @@ namespace loc{
             int rows, cols;
             std::vector<Triplet> tripletList;
             {
-                cv::Mat image = cv::imread(filepath);
                 cols = image.cols;
                 rows = image.rows;
                 for(int y=0; y<image.rows; y++){
@@ -293,7 +434,6 @@ namespace loc{
                     }
                 }
                 mat_ = Eigen::SparseMatrix<uint8_t>(rows, cols);
-                image.release();
             }
             
             mat_.setFromTriplets(tripletList.begin(), tripletList.end());
@@ -350,8 +490,18 @@ namespace loc{
             return color;
         }
         
+        uint8_t getLabel(int y, int x) const override{
+            if(0<=y && y<rows() && 0<=x && x<cols()){
+                return mat_.coeff(y,x);
+            }
+            return label::white;
+        }
+        
         std::vector<Point> getPoints(const Color& c) const{
             Points points;
+            if(ImageHolder::colorToLabel(c)==label::unknown){
+                return points;
+            }
             uint8_t code_q = colorToUint8(c);
             for(int k=0; k<mat_.outerSize(); k++){
                 auto iter = Eigen::SparseMatrix<uint8_t>::InnerIterator(mat_, k);
@@ -369,11 +519,174 @@ namespace loc{
         }
     };
     
+    /**
+     Labels are stored row-major in a 64-byte aligned buffer with a one-pixel white border and a row stride
+     rounded up to a cache line. Coordinates are clamped into the border so that access has no branch.
+     **/
+    class ImageHolder::ImplDense : public ImageHolder::Impl{
+        static constexpr size_t alignment = 64;
+        
+        std::string name_;
+        int rows_ = 0;
+        int cols_ = 0;
+        size_t stride_ = 0;
+        std::shared_ptr<uint8_t> buffer_;
+        uint8_t* origin_ = nullptr; // pixel (0, 0)
+        
+        void allocate(int rows, int cols){
+            rows_ = rows;
+            cols_ = cols;
+            stride_ = ((cols_ + 2 + alignment - 1)/alignment)*alignment;
+            size_t size = stride_*(rows_ + 2);
+            void* ptr = nullptr;
+            if(posix_memalign(&ptr, alignment, size)!=0){
+                BOOST_THROW_EXCEPTION(LocException("Failed to allocate a label raster."));
+            }
+            buffer_.reset(static_cast<uint8_t*>(ptr), [](uint8_t* p){ free(p); });
+            std::memset(buffer_.get(), label::white, size);
+            origin_ = buffer_.get() + stride_ + 1;
+        }
+        
+    public:
+        ImplDense(){
+            allocate(0, 0);
+        }
+        ImplDense(const std::string& filepath, const std::string& name) : ImplDense(readImage(filepath), name){}
+        ImplDense(const cv::Mat& image, const std::string& name){
+            checkImageType(image);
+            name_ = name;
+            allocate(image.rows, image.cols);
+            
+            for(int y=0; y<rows_; y++){
+                const cv::Vec3b* row = image.ptr<cv::Vec3b>(y);
+                uint8_t* labels = origin_ + y*stride_;
+                for(int x=0; x<cols_; x++){
+                    const cv::Vec3b& vec = row[x];
+                    labels[x] = pixelLabel(Color(vec[2], vec[1], vec[0]));
+                }
+            }
+            
+            this->setUpIndices();
+        }
+        // labels: row-major labels of rows*cols pixels
+        ImplDense(int rows, int cols, const std::vector<uint8_t>& labels, const std::string& name){
+            name_ = name;
+            allocate(rows, cols);
+            for(int y=0; y<rows_; y++){
+                std::memcpy(origin_ + y*stride_, &labels[y*(size_t)cols_], cols_);
+            }
+            
+            this->setUpIndices();
+        }
+        ~ImplDense() = default;
+        
+        int rows() const{
+            return rows_;
+        }
+        int cols() const{
+            return cols_;
+        }
+        
+        uint8_t getLabel(int y, int x) const override{
+            y = std::min(std::max(y, -1), rows_);
+            x = std::min(std::max(x, -1), cols_);
+            return origin_[y*(long)stride_ + x];
+        }
+        
+        Color get(int y, int x) const{
+            uint8_t code = getLabel(y, x);
+            return code<colorList.size() ? colorList[code] : color::white;
+        }
+        
+        std::vector<Point> getPoints(const Color& c) const{
+            Points points;
+            uint8_t code_q = ImageHolder::colorToLabel(c);
+            for(int y=0; y<rows_; y++){
+                const uint8_t* labels = origin_ + y*stride_;
+                for(int x=0; x<cols_; x++){
+                    if(labels[x]==code_q){
+                        points.push_back(Point(x, y));
+                    }
+                }
+            }
+            return points;
+        }
+    };
+    
+    /**
+     Labels are read from a TiledLabelStore. Indices of colors are set up when they are first queried.
+     **/
+    class ImageHolder::ImplTiled : public ImageHolder::Impl{
+        std::string name_;
+        TiledLabelStore::Ptr store_;
+        
+    public:
+        ImplTiled(TiledLabelStore::Ptr store, const std::string& name){
+            name_ = name;
+            store_ = store;
+        }
+        ~ImplTiled() = default;
+        
+        bool isTiled() const override{
+            return true;
+        }
+        
+        int rows() const{
+            return store_->rows();
+        }
+        int cols() const{
+            return store_->cols();
+        }
+        
+        uint8_t getLabel(int y, int x) const override{
+            return store_->getLabel(y, x);
+        }
+        
+        Color get(int y, int x) const{
+            uint8_t code = getLabel(y, x);
+            return code<colorList.size() ? colorList[code] : color::white;
+        }
+        
+        // The nearest-site raster stored with the tiles is used in place of setUpNearestSiteRaster of the other modes.
+        Points findClosestPoint(const std::vector<Color>& colors, const ImageHolder::Point& p) const override{
+            if(store_->siteLabels()!=0 && labelMask(colors)==store_->siteLabels()){
+                Points psRet;
+                int ySite, xSite;
+                if(store_->nearestSite(p.y, p.x, ySite, xSite)){
+                    psRet.push_back(Point(xSite, ySite));
+                }
+                return psRet;
+            }
+            return Impl::findClosestPoint(colors, p);
+        }
+        
+        std::vector<Point> getPoints(const Color& c) const{
+            Points points;
+            uint8_t code_q = ImageHolder::colorToLabel(c);
+            int tileSize = store_->tileSize();
+            // Scanned tile by tile so that each tile is loaded once.
+            for(int ty=0; ty<rows(); ty+=tileSize){
+                for(int tx=0; tx<cols(); tx+=tileSize){
+                    for(int y=ty; y<std::min(ty+tileSize, rows()); y++){
+                        for(int x=tx; x<std::min(tx+tileSize, cols()); x++){
+                            if(store_->getLabel(y, x)==code_q){
+                                points.push_back(Point(x, y));
+                            }
+                        }
+                    }
+                }
+            }
+            return points;
+        }
+    };
+    
     ImageHolder::ImageHolder(){
         if(mode_ == light){
             impl.reset(new ImplLight());
         }else if (mode_ == heavy){
             impl.reset(new ImplHeavy());
+        }else if (mode_ == dense){
+            impl.reset(new ImplDense());
         }else{
             BOOST_THROW_EXCEPTION(LocException("Unknown ImageHolderMode."));
         }
@@ -386,6 +699,21 @@ namespace loc{
         }else if (mode_ == heavy){
             std::cout << "ImageHolder::ImplHeavy is instantiated." << std::endl;
             impl.reset(new ImplHeavy(filepath, name));
+        }else if (mode_ == dense){
+            std::cout << "ImageHolder::ImplDense is instantiated." << std::endl;
+            impl.reset(new ImplDense(filepath, name));
+        }else{
+            BOOST_THROW_EXCEPTION(LocException("Unknown ImageHolderMode."));
+        }
+    }
+    
+    ImageHolder::ImageHolder(const cv::Mat& image, const std::string& name){
+        if(mode_ == light){
+            impl.reset(new ImplLight(image, name));
+        }else if (mode_ == heavy){
+            impl.reset(new ImplHeavy(image, name));
+        }else if (mode_ == dense){
+            impl.reset(new ImplDense(image, name));
         }else{
             BOOST_THROW_EXCEPTION(LocException("Unknown ImageHolderMode."));
         }
@@ -393,6 +721,80 @@ namespace loc{
     
     ImageHolder::~ImageHolder(){}
     
+    ImageHolder ImageHolder::decode(const std::string& encoded, const std::string& name){
+        cv::Mat buffer(1, static_cast<int>(encoded.size()), CV_8UC1, const_cast<char*>(encoded.data()));
+        cv::Mat image = cv::imdecode(buffer, cv::IMREAD_COLOR);
+        if(image.empty()){
+            BOOST_THROW_EXCEPTION(LocException("Failed to decode the image of " + name));
+        }
+        return ImageHolder(image, name);
+    }
+    
+    // Version 2: pixels of colors outside the color list are stored as white.
+    static const char labelsMagic[4] = {'L', 'B', 'L', '2'};
+    
+    void ImageHolder::writeLabels(std::ostream& os) const{
+        int32_t size[2] = {rows(), cols()};
+        os.write(labelsMagic, sizeof(labelsMagic));
+        os.write(reinterpret_cast<const char*>(size), sizeof(size));
+        std::vector<uint8_t> row(size[1]);
+        for(int y=0; y<size[0]; y++){
+            for(int x=0; x<size[1]; x++){
+                row[x] = impl->getLabel(y, x);
+            }
+            os.write(reinterpret_cast<const char*>(row.data()), row.size());
+        }
+    }
+    
+    ImageHolder ImageHolder::openTiles(const std::string& path, const std::string& name, TileCache::Ptr cache){
+        ImageHolder holder;
+        holder.impl.reset(new ImplTiled(std::make_shared<TiledLabelStore>(path, cache), name));
+        return holder;
+    }
+    
+    void ImageHolder::writeTiles(const std::string& path, int tileSize, const std::vector<Color>& siteColors) const{
+        TiledLabelStore::write(path, rows(), cols(), [this](int y, int x){
+            return impl->getLabel(y, x);
+        }, tileSize, labelMaskOf(siteColors));
+    }
+    
+    bool ImageHolder::isTiled() const{
+        return impl->isTiled();
+    }
+    
+    ImageHolder ImageHolder::readLabels(std::istream& is, const std::string& name){
+        char magic[4];
+        int32_t size[2];
+        is.read(magic, sizeof(magic));
+        is.read(reinterpret_cast<char*>(size), sizeof(size));
+        if(!is || std::memcmp(magic, labelsMagic, sizeof(magic))!=0 || size[0]<0 || size[1]<0){
+            BOOST_THROW_EXCEPTION(LocException("Invalid label raster of " + name));
+        }
+        std::vector<uint8_t> labels(static_cast<size_t>(size[0])*size[1]);
+        is.read(reinterpret_cast<char*>(labels.data()), labels.size());
+        if(!is){
+            BOOST_THROW_EXCEPTION(LocException("Truncated label raster of " + name));
+        }
+        ImageHolder holder;
+        if(mode_ == dense){
+            holder.impl.reset(new ImplDense(size[0], size[1], labels, name));
+        }else{
+            cv::Mat image(size[0], size[1], CV_8UC3);
+            for(int y=0; y<size[0]; y++){
+                cv::Vec3b* row = image.ptr<cv::Vec3b>(y);
+                for(int x=0; x<size[1]; x++){
+                    uint8_t l = labels[y*(size_t)size[1] + x];
+                    const Color& c = l<colorList.size() ? colorList[l] : color::white;
+                    row[x][0] = c.b_;
+                    row[x][1] = c.g_;
+                    row[x][2] = c.r_;
+                }
+            }
+            holder = ImageHolder(image, name);
+        }
+        return holder;
+    }
+    
     void ImageHolder::setMode(ImageHolderMode mode){
         mode_ = mode;
     }
@@ -409,6 +811,10 @@ namespace loc{
         return impl->get(y, x);
     }
     
+    uint8_t ImageHolder::getLabel(int y, int x) const{
+        return impl->getLabel(y, x);
+    }
+    
     void ImageHolder::setUpIndexForColor(const loc::Color &c){
         impl->setUpIndexForColor(c);
     }
@@ -421,6 +827,14 @@ namespace loc{
         return impl->findClosestPoints(c, p, k);
     }
     
+    void ImageHolder::setUpNearestSiteRaster(const std::vector<Color>& colors){
+        impl->setUpNearestSiteRaster(colors);
+    }
+    
+    ImageHolder::Points ImageHolder::findClosestPoint(const std::vector<Color>& colors, const ImageHolder::Point& p) const{
+        return impl->findClosestPoint(colors, p);
+    }
+    
     void ImageHolder::setPrecomputesIndex(bool precomputesIdx){
         ImageHolder::precomputesIndex = precomputesIdx;
     }
@@ -27,11 +27,13 @@
 #include <iostream>
 #include <memory>
 #include <opencv2/opencv.hpp>
+#include "TiledLabelStore.hpp"
 
 namespace loc {
 
+    // light: sparse label matrix, heavy: 3-channel image, dense: packed 8-bit label raster with O(1) access
     enum ImageHolderMode{
-        light=0,heavy=1
+        light=0,heavy=1,dense=2
     };
     
     //Color struct is defined to keep color in RGB format.
@@ -64,6 +66,19 @@ namespace loc {
         const Color teal(0,128,128);
         const Color maroon(128,0,0);
     }
+    
+    // Labels of the colors used in maps (indices of the color list). Colors outside the list are labeled unknown by
+    // ImageHolder::colorToLabel, but pixels having them are read as white (floor) by every ImageHolderMode.
+    namespace label{
+        constexpr uint8_t white = 0;
+        constexpr uint8_t black = 1;
+        constexpr uint8_t red = 2;
+        constexpr uint8_t lime = 3;
+        constexpr uint8_t blue = 4;
+        constexpr uint8_t yellow = 5;
+        constexpr uint8_t green = 6;
+        constexpr uint8_t unknown = 255;
+    }
         
     class ImageHolder{
         std::string name_;
@@ -72,6 +87,8 @@ namespace loc {
         class Impl;
         class ImplHeavy;
         class ImplLight;
+        class ImplDense;
+        class ImplTiled;
         std::shared_ptr<Impl> impl;
         
         static ImageHolderMode mode_;
@@ -91,8 +108,21 @@ namespace loc {
         
         ImageHolder();
         ImageHolder(const std::string& filepath, const std::string& name);
+        // image: 8-bit 3-channel (BGR) image
+        ImageHolder(const cv::Mat& image, const std::string& name);
         ~ImageHolder();
         
+        // Decodes an encoded image (e.g. the bytes of a PNG file) in memory.
+        static ImageHolder decode(const std::string& encoded, const std::string& name);
+        // Binary label raster used to cache preprocessed maps.
+        void writeLabels(std::ostream& os) const;
+        static ImageHolder readLabels(std::istream& is, const std::string& name);
+        // Labels backed by a memory-mapped tiled file (see TiledLabelStore). Tiles are loaded when they are accessed.
+        static ImageHolder openTiles(const std::string& path, const std::string& name, TileCache::Ptr cache = nullptr);
+        // The nearest-site raster of siteColors is stored with the tiles and used by findClosestPoint of the colors.
+        void writeTiles(const std::string& path, int tileSize = TiledLabelStore::defaultTileSize, const std::vector<Color>& siteColors = {}) const;
+        bool isTiled() const;
+        
         static void setMode(ImageHolderMode mode);
         
         int rows() const;
@@ -100,11 +130,20 @@ namespace loc {
         
         bool checkValid(int y, int x) const;
         Color get(int y, int x) const;
+        // Label of the pixel. Pixels outside the image are labeled white.
+        uint8_t getLabel(int y, int x) const;
+        static uint8_t colorToLabel(const Color& c);
         
         void setUpIndexForColor(const Color& c);
         std::vector<Point> getPoints(const Color& c) const;
         Points findClosestPoints(const Color&c, const Point& p, int k=1) const;
         
+        // Precomputes a raster storing the closest pixel having any of the colors for every pixel.
+        // Call this when the image is loaded; queries on the raster afterwards are O(1) and take no lock.
+        void setUpNearestSiteRaster(const std::vector<Color>& colors);
+        // Closest pixel having any of the colors. Empty when there is no such pixel.
+        Points findClosestPoint(const std::vector<Color>& colors, const Point& p) const;
+        
         static void setPrecomputesIndex(bool precomputesIdx);
         
     };
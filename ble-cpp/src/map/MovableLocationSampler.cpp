@@ -0,0 +1,310 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#include "MovableLocationSampler.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <atomic>
+#include <array>
+
+namespace loc{
+    
+    static int popcount16(uint16_t mask){
+        return __builtin_popcount(mask);
+    }
+    
+    MovableLocationSampler::MovableLocationSampler(const Building& building){
+        static std::atomic<unsigned long> nSamplers(0);
+        mId = ++nSamplers;
+        for(int floor: building.floorNumbers()){
+            const FloorMap& floorMap = building.getFloorAt(floor);
+            const ImageHolder& image = floorMap.image();
+            FloorIndex& index = mFloors[floor];
+            index.coordSys = floorMap.coordinateSystem();
+            Location o = index.coordSys.worldToLocalState(Location(0, 0, 0, floor));
+            Location u = index.coordSys.worldToLocalState(Location(1, 1, 0, floor));
+            index.scaleX = std::abs(u.x() - o.x());
+            index.scaleY = std::abs(u.y() - o.y());
+            index.rows = image.rows();
+            index.cols = image.cols();
+            index.nCellsX = (index.cols + cellSize - 1)/cellSize;
+            index.nCellsY = (index.rows + cellSize - 1)/cellSize;
+            
+            size_t nCells = static_cast<size_t>(index.nCellsX)*index.nCellsY;
+            index.masks.assign(nCells, 0);
+            std::vector<double> counts(nCells);
+            for(int cy=0; cy<index.nCellsY; cy++){
+                for(int cx=0; cx<index.nCellsX; cx++){
+                    uint16_t mask = 0;
+                    for(int dy=0; dy<cellSize; dy++){
+                        for(int dx=0; dx<cellSize; dx++){
+                            int y = cy*cellSize + dy;
+                            int x = cx*cellSize + dx;
+                            if(y<index.rows && x<index.cols && image.getLabel(y, x)!=label::labelWall){
+                                mask |= 1 << (dy*cellSize + dx);
+                            }
+                        }
+                    }
+                    size_t c = cy*(size_t)index.nCellsX + cx;
+                    index.masks[c] = mask;
+                    counts[c] = popcount16(mask);
+                    index.nMovable += popcount16(mask);
+                }
+            }
+            index.cellTable.reset(counts.data(), counts.size());
+        }
+    }
+    
+    bool MovableLocationSampler::FloorIndex::isMovable(int y, int x) const{
+        if(y<0 || rows<=y || x<0 || cols<=x){
+            return false;
+        }
+        uint16_t mask = masks[(y/cellSize)*(size_t)nCellsX + x/cellSize];
+        return (mask >> ((y%cellSize)*cellSize + x%cellSize)) & 1;
+    }
+    
+    bool MovableLocationSampler::hasFloor(int floor) const{
+        return mFloors.count(floor)!=0;
+    }
+    
+    size_t MovableLocationSampler::countMovablePixels(int floor) const{
+        auto iter = mFloors.find(floor);
+        return iter==mFloors.end() ? 0 : iter->second.nMovable;
+    }
+    
+    int MovableLocationSampler::selectBit(uint16_t mask, int k){
+        for(int b=0; b<cellSize*cellSize; b++){
+            if((mask >> b) & 1){
+                if(k==0){
+                    return b;
+                }
+                k--;
+            }
+        }
+        return -1;
+    }
+    
+    void MovableLocationSampler::pixelToLocation(const FloorIndex& index, int y, int x, RandomGenerator& rand, Location& location){
+        // Uniform in the pixel, kept strictly inside so that rounding returns the same pixel.
+        Location local(location);
+        local.x(x + (rand.nextDouble() - 0.5)*0.999);
+        local.y(y + (rand.nextDouble() - 0.5)*0.999);
+        Location world = index.coordSys.localToWorldState(local);
+        location.x(world.x());
+        location.y(world.y());
+    }
+    
+    bool MovableLocationSampler::sampleUniform(int floor, RandomGenerator& rand, Location& location) const{
+        auto iter = mFloors.find(floor);
+        if(iter==mFloors.end() || iter->second.nMovable==0){
+            return false;
+        }
+        const FloorIndex& index = iter->second;
+        size_t c = index.cellTable.sample(rand.nextDouble(), rand.nextDouble());
+        uint16_t mask = index.masks[c];
+        int n = popcount16(mask);
+        int b = selectBit(mask, std::min(n-1, static_cast<int>(rand.nextDouble()*n)));
+        int cy = static_cast<int>(c/index.nCellsX);
+        int cx = static_cast<int>(c%index.nCellsX);
+        location.floor(floor);
+        pixelToLocation(index, cy*cellSize + b/cellSize, cx*cellSize + b%cellSize, rand, location);
+        return true;
+    }
+    
+    bool MovableLocationSampler::prepareGaussian(const Location& mean, double stdx, double stdy, Gaussian& gaussian) const{
+        auto iter = mFloors.find(static_cast<int>(mean.floor()));
+        if(iter==mFloors.end()){
+            return false;
+        }
+        const FloorIndex& index = iter->second;
+        gaussian.index = &index;
+        gaussian.mean = mean;
+        gaussian.localMean = index.coordSys.worldToLocalState(mean);
+        gaussian.sx = std::max(std::abs(stdx)*index.scaleX, 1.0e-3);
+        gaussian.sy = std::max(std::abs(stdy)*index.scaleY, 1.0e-3);
+        gaussian.hasTable = false;
+        return true;
+    }
+    
+    // 3-sigma window in pixels
+    void MovableLocationSampler::windowOf(const Gaussian& gaussian, int& y0, int& x0, int& y1, int& x1){
+        double mx = gaussian.localMean.x();
+        double my = gaussian.localMean.y();
+        x0 = static_cast<int>(std::floor(mx - 3*gaussian.sx - 0.5));
+        x1 = static_cast<int>(std::ceil(mx + 3*gaussian.sx + 0.5));
+        y0 = static_cast<int>(std::floor(my - 3*gaussian.sy - 0.5));
+        y1 = static_cast<int>(std::ceil(my + 3*gaussian.sy + 0.5));
+    }
+    
+    // Density restricted to the movable pixels (small windows) or cells (large windows, weighted at the cell center)
+    bool MovableLocationSampler::buildTable(Gaussian& gaussian){
+        const FloorIndex& index = *gaussian.index;
+        gaussian.hasTable = true;
+        gaussian.candidates.clear();
+        
+        int y0, x0, y1, x1;
+        windowOf(gaussian, y0, x0, y1, x1);
+        x0 = std::max(x0, 0);
+        y0 = std::max(y0, 0);
+        x1 = std::min(x1, index.cols-1);
+        y1 = std::min(y1, index.rows-1);
+        if(x1<x0 || y1<y0){
+            return false;
+        }
+        
+        static thread_local std::vector<double> exponents;
+        exponents.clear();
+        double mx = gaussian.localMean.x();
+        double my = gaussian.localMean.y();
+        auto exponent = [&](double x, double y){
+            double dx = (x - mx)/gaussian.sx;
+            double dy = (y - my)/gaussian.sy;
+            return 0.5*(dx*dx + dy*dy);
+        };
+        
+        long nPixels = static_cast<long>(x1-x0+1)*(y1-y0+1);
+        gaussian.perPixel = nPixels <= 1024;
+        if(gaussian.perPixel){
+            for(int y=y0; y<=y1; y++){
+                for(int x=x0; x<=x1; x++){
+                    if(index.isMovable(y, x)){
+                        exponents.push_back(exponent(x, y));
+                        gaussian.candidates.push_back(static_cast<uint32_t>(y*(size_t)index.cols + x));
+                    }
+                }
+            }
+        }else{
+            for(int cy=y0/cellSize; cy<=y1/cellSize; cy++){
+                for(int cx=x0/cellSize; cx<=x1/cellSize; cx++){
+                    size_t c = cy*(size_t)index.nCellsX + cx;
+                    if(index.masks[c]!=0){
+                        double center = (cellSize - 1)/2.0;
+                        exponents.push_back(exponent(cx*cellSize + center, cy*cellSize + center) - std::log(popcount16(index.masks[c])));
+                        gaussian.candidates.push_back(static_cast<uint32_t>(c));
+                    }
+                }
+            }
+        }
+        if(gaussian.candidates.empty()){
+            return false;
+        }
+        // Relative to the largest density so that narrow distributions do not underflow
+        double minExponent = *std::min_element(exponents.begin(), exponents.end());
+        for(double& e: exponents){
+            e = std::exp(minExponent - e);
+        }
+        return gaussian.table.reset(exponents.data(), exponents.size());
+    }
+    
+    // Rejection against the bit masks. Both an accepted draw and a table draw after rejections follow the density
+    // restricted to movable pixels (the table up to its window and resolution), so the fallback does not bias the draws.
+    bool MovableLocationSampler::drawDirectly(const Gaussian& gaussian, RandomGenerator& rand, Location& location){
+        const FloorIndex& index = *gaussian.index;
+        for(int i=0; i<nDirectDraws; i++){
+            double x = gaussian.localMean.x() + gaussian.sx*rand.nextGaussian();
+            double y = gaussian.localMean.y() + gaussian.sy*rand.nextGaussian();
+            if(index.isMovable(static_cast<int>(std::round(y)), static_cast<int>(std::round(x)))){
+                Location local(gaussian.localMean);
+                local.x(x);
+                local.y(y);
+                Location world = index.coordSys.localToWorldState(local);
+                location = gaussian.mean;
+                location.x(world.x());
+                location.y(world.y());
+                return true;
+            }
+        }
+        return false;
+    }
+    
+    bool MovableLocationSampler::drawFromTable(Gaussian& gaussian, RandomGenerator& rand, Location& location){
+        const FloorIndex& index = *gaussian.index;
+        if(!gaussian.hasTable){
+            buildTable(gaussian);
+        }
+        if(gaussian.candidates.empty()){
+            return false;
+        }
+        uint32_t selected = gaussian.candidates[gaussian.table.sample(rand.nextDouble(), rand.nextDouble())];
+        
+        int y, x;
+        if(gaussian.perPixel){
+            y = static_cast<int>(selected/index.cols);
+            x = static_cast<int>(selected%index.cols);
+        }else{
+            uint16_t mask = index.masks[selected];
+            int n = popcount16(mask);
+            int b = selectBit(mask, std::min(n-1, static_cast<int>(rand.nextDouble()*n)));
+            y = static_cast<int>(selected/index.nCellsX)*cellSize + b/cellSize;
+            x = static_cast<int>(selected%index.nCellsX)*cellSize + b%cellSize;
+        }
+        location = gaussian.mean;
+        pixelToLocation(index, y, x, rand, location);
+        return true;
+    }
+    
+    bool MovableLocationSampler::sampleGaussian(Gaussian& gaussian, RandomGenerator& rand, Location& location) const{
+        if(gaussian.index==nullptr){
+            return false;
+        }
+        return drawDirectly(gaussian, rand, location) || drawFromTable(gaussian, rand, location);
+    }
+    
+    bool MovableLocationSampler::sampleGaussian(const Location& mean, double stdx, double stdy, RandomGenerator& rand, Location& location) const{
+        struct Cached{
+            unsigned long samplerId = 0;
+            double x, y, z, floor, stdx, stdy;
+            Gaussian gaussian;
+        };
+        static thread_local std::array<Cached, 4> cache;
+        static thread_local size_t next = 0;
+        
+        for(Cached& c: cache){
+            if(c.samplerId==mId && c.x==mean.x() && c.y==mean.y() && c.z==mean.z() && c.floor==mean.floor()
+               && c.stdx==stdx && c.stdy==stdy){
+                return sampleGaussian(c.gaussian, rand, location);
+            }
+        }
+        // A moving mean rarely hits the cache, so the table is built and cached only after the direct draws are rejected.
+        Gaussian gaussian;
+        if(!prepareGaussian(mean, stdx, stdy, gaussian)){
+            return false;
+        }
+        if(drawDirectly(gaussian, rand, location)){
+            return true;
+        }
+        Cached& c = cache[next];
+        next = (next+1)%cache.size();
+        std::swap(c.gaussian, gaussian); // reuses the buffers of the evicted entry
+        c.gaussian.hasTable = false;
+        c.samplerId = mId;
+        c.x = mean.x();
+        c.y = mean.y();
+        c.z = mean.z();
+        c.floor = mean.floor();
+        c.stdx = stdx;
+        c.stdy = stdy;
+        return drawFromTable(c.gaussian, rand, location);
+    }
+    
+}
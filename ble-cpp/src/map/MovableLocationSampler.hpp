@@ -0,0 +1,119 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef MovableLocationSampler_hpp
+#define MovableLocationSampler_hpp
+
+#include <stdio.h>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "Building.hpp"
+#include "RandomGenerator.hpp"
+#include "AliasTable.hpp"
+
+namespace loc{
+    
+    /**
+     Draws movable locations of a building without rejection.
+     Movable pixels of each floor are indexed by cells of cellSize x cellSize pixels with a bit mask per cell.
+     Uniform sampling draws a cell from an alias table weighted by the number of movable pixels.
+     Gaussian sampling first tries a few direct draws checked against the bit masks, and only after they are all rejected
+     draws a pixel (small windows) or a cell (large windows, weighted at the cell center) in proportion to the density
+     restricted to movable pixels.
+     Pixels outside the floor images are not movable here.
+     **/
+    class MovableLocationSampler{
+        struct FloorIndex;
+        
+    public:
+        using Ptr = std::shared_ptr<MovableLocationSampler>;
+        
+        static constexpr int cellSize = 4;
+        // Direct draws tried before a Gaussian falls back to its alias table
+        static constexpr int nDirectDraws = 16;
+        
+        /**
+         Gaussian around a mean restricted to movable locations. The alias table over the window is built at the first
+         draw whose direct draws are all rejected and reused by later draws.
+         **/
+        class Gaussian{
+            friend class MovableLocationSampler;
+            const FloorIndex* index = nullptr;
+            Location mean;
+            Location localMean;
+            double sx = 0;
+            double sy = 0;
+            bool perPixel = false;
+            bool hasTable = false;
+            std::vector<uint32_t> candidates;
+            AliasTable table;
+        };
+        
+        MovableLocationSampler(const Building& building);
+        ~MovableLocationSampler() = default;
+        
+        bool hasFloor(int floor) const;
+        size_t countMovablePixels(int floor) const;
+        
+        // Uniform movable location on the floor. Returns false when the floor has no movable pixel.
+        bool sampleUniform(int floor, RandomGenerator& rand, Location& location) const;
+        // Location drawn from the Gaussian around mean (standard deviations in world coordinates) restricted to movable
+        // locations on the floor of mean. Returns false when there is no movable pixel around mean.
+        // Draws directly in O(1) in most cases. Only Gaussians that needed a table are cached per thread, so that repeated
+        // draws around the same mean in a mostly unmovable area reuse their tables.
+        bool sampleGaussian(const Location& mean, double stdx, double stdy, RandomGenerator& rand, Location& location) const;
+        // Prepares the Gaussian for repeated draws. Returns false when the floor of mean is not indexed.
+        bool prepareGaussian(const Location& mean, double stdx, double stdy, Gaussian& gaussian) const;
+        bool sampleGaussian(Gaussian& gaussian, RandomGenerator& rand, Location& location) const;
+        
+    private:
+        struct FloorIndex{
+            CoordinateSystem coordSys;
+            double scaleX; // local / world
+            double scaleY;
+            int rows;
+            int cols;
+            int nCellsX;
+            int nCellsY;
+            std::vector<uint16_t> masks; // bit (dy*cellSize + dx) is set for a movable pixel
+            AliasTable cellTable;
+            size_t nMovable = 0;
+            
+            bool isMovable(int y, int x) const;
+        };
+        std::map<int, FloorIndex> mFloors;
+        // Distinguishes samplers in the per-thread cache of Gaussians
+        unsigned long mId;
+        
+        static void pixelToLocation(const FloorIndex& index, int y, int x, RandomGenerator& rand, Location& location);
+        static int selectBit(uint16_t mask, int k);
+        static void windowOf(const Gaussian& gaussian, int& y0, int& x0, int& y1, int& x1);
+        static bool buildTable(Gaussian& gaussian);
+        static bool drawDirectly(const Gaussian& gaussian, RandomGenerator& rand, Location& location);
+        static bool drawFromTable(Gaussian& gaussian, RandomGenerator& rand, Location& location);
+    };
+    
+}
+
+#endif /* MovableLocationSampler_hpp */
@@ -0,0 +1,142 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#include "NearestSiteRaster.hpp"
+#include "LocException.hpp"
+#include <limits>
+
+namespace loc{
+    
+    constexpr uint32_t NearestSiteRaster::none;
+    
+    NearestSiteRaster::NearestSiteRaster(int rows, int cols, const std::function<bool(int y, int x)>& isSite)
+    : mRows(rows), mCols(cols)
+    {
+        if(65535 < rows || 65535 < cols){
+            BOOST_THROW_EXCEPTION(LocException("Image is too large for NearestSiteRaster."));
+        }
+        size_t size = static_cast<size_t>(rows)*cols;
+        mNearest.assign(size, none);
+        
+        // Closest site row in each column
+        std::vector<int> siteRow(size, -1);
+        for(int x=0; x<cols; x++){
+            int last = -1;
+            for(int y=0; y<rows; y++){
+                if(isSite(y, x)){
+                    last = y;
+                    mSites.push_back((static_cast<uint32_t>(y)<<16) | x);
+                }
+                siteRow[y*(size_t)cols + x] = last;
+            }
+            last = -1;
+            for(int y=rows-1; 0<=y; y--){
+                int& r = siteRow[y*(size_t)cols + x];
+                if(r==y){
+                    last = y;
+                }else if(last!=-1 && (r==-1 || last-y < y-r)){
+                    r = last;
+                }
+            }
+        }
+        if(mSites.empty()){
+            return;
+        }
+        
+        // Lower envelope of parabolas along each row (Felzenszwalb and Huttenlocher) over the columns having a site
+        std::vector<int> v(cols);
+        std::vector<double> z(cols+1);
+        std::vector<double> f(cols);
+        for(int y=0; y<rows; y++){
+            const int* rowSites = &siteRow[y*(size_t)cols];
+            int k = -1;
+            for(int q=0; q<cols; q++){
+                if(rowSites[q]==-1){
+                    continue;
+                }
+                double dy = y - rowSites[q];
+                f[q] = dy*dy;
+                if(k<0){
+                    k = 0;
+                    v[0] = q;
+                    z[0] = -std::numeric_limits<double>::infinity();
+                    z[1] = std::numeric_limits<double>::infinity();
+                    continue;
+                }
+                double s = ((f[q] + (double)q*q) - (f[v[k]] + (double)v[k]*v[k]))/(2.0*(q - v[k]));
+                while(s <= z[k]){
+                    k--;
+                    s = ((f[q] + (double)q*q) - (f[v[k]] + (double)v[k]*v[k]))/(2.0*(q - v[k]));
+                }
+                k++;
+                v[k] = q;
+                z[k] = s;
+                z[k+1] = std::numeric_limits<double>::infinity();
+            }
+            if(k<0){
+                continue;
+            }
+            k = 0;
+            uint32_t* nearest = &mNearest[y*(size_t)cols];
+            for(int q=0; q<cols; q++){
+                while(z[k+1] < q){
+                    k++;
+                }
+                int xs = v[k];
+                nearest[q] = (static_cast<uint32_t>(rowSites[xs])<<16) | xs;
+            }
+        }
+    }
+    
+    size_t NearestSiteRaster::nSites() const{
+        return mSites.size();
+    }
+    
+    bool NearestSiteRaster::nearest(int y, int x, int& ySite, int& xSite) const{
+        if(mSites.empty()){
+            return false;
+        }
+        uint32_t code = none;
+        if(0<=y && y<mRows && 0<=x && x<mCols){
+            code = mNearest[y*(size_t)mCols + x];
+        }else{
+            // Queries outside the image scan the sites.
+            double dmin = std::numeric_limits<double>::max();
+            for(uint32_t s: mSites){
+                double dy = y - static_cast<int>(s>>16);
+                double dx = x - static_cast<int>(s & 0xFFFF);
+                double d = dx*dx + dy*dy;
+                if(d < dmin){
+                    dmin = d;
+                    code = s;
+                }
+            }
+        }
+        if(code==none){
+            return false;
+        }
+        ySite = static_cast<int>(code>>16);
+        xSite = static_cast<int>(code & 0xFFFF);
+        return true;
+    }
+    
+}
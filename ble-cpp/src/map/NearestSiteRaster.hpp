@@ -0,0 +1,61 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef NearestSiteRaster_hpp
+#define NearestSiteRaster_hpp
+
+#include <stdio.h>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace loc{
+    
+    /**
+     Feature transform of an image: every pixel stores the coordinates of its closest site pixel (Euclidean),
+     so that a nearest-site query inside the image is a single lookup. The raster is immutable after construction
+     and can be queried from multiple threads.
+     **/
+    class NearestSiteRaster{
+    public:
+        using Ptr = std::shared_ptr<NearestSiteRaster>;
+        
+        NearestSiteRaster(int rows, int cols, const std::function<bool(int y, int x)>& isSite);
+        ~NearestSiteRaster() = default;
+        
+        size_t nSites() const;
+        // Returns false when there is no site.
+        bool nearest(int y, int x, int& ySite, int& xSite) const;
+        
+    private:
+        static constexpr uint32_t none = 0xFFFFFFFF;
+        
+        int mRows;
+        int mCols;
+        std::vector<uint32_t> mNearest; // (y << 16) | x of the closest site
+        std::vector<uint32_t> mSites;
+    };
+    
+}
+
+#endif /* NearestSiteRaster_hpp */
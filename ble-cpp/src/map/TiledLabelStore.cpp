@@ -0,0 +1,343 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#include "TiledLabelStore.hpp"
+#include "LocException.hpp"
+#include "NearestSiteRaster.hpp"
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace loc{
+    
+    // Version 2: pixels of colors outside the color list are stored as white.
+    // Version 3: nearest-site raster
+    static const char tilesMagic[4] = {'T', 'L', 'B', '3'};
+    static constexpr int nHeaderValues = 5;
+    static constexpr uint32_t noSite = 0xFFFFFFFF;
+    
+    static uint64_t tileKey(uint32_t storeId, uint32_t tileIndex){
+        return (static_cast<uint64_t>(storeId) << 32) | tileIndex;
+    }
+    
+    TileCache::Ptr TileCache::shared(){
+        static TileCache::Ptr cache = std::make_shared<TileCache>();
+        return cache;
+    }
+    
+    TileCache& TileCache::capacityBytes(size_t bytes){
+        std::lock_guard<std::mutex> lock(mMutex);
+        mCapacityBytes = bytes;
+        evict();
+        return *this;
+    }
+    
+    size_t TileCache::capacityBytes() const{
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mCapacityBytes;
+    }
+    
+    size_t TileCache::residentBytes() const{
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mResidentBytes;
+    }
+    
+    void TileCache::touch(const TiledLabelStore& store, uint32_t tileIndex){
+        std::lock_guard<std::mutex> lock(mMutex);
+        uint64_t key = tileKey(store.mId, tileIndex);
+        auto iter = mEntries.find(key);
+        if(iter!=mEntries.end()){
+            mLRU.splice(mLRU.begin(), mLRU, iter->second);
+            return;
+        }
+        size_t bytes = store.tileBytes(tileIndex);
+        mLRU.push_front(Entry{&store, key, bytes});
+        mEntries[key] = mLRU.begin();
+        mResidentBytes += bytes;
+        evict();
+    }
+    
+    void TileCache::remove(const TiledLabelStore& store){
+        std::lock_guard<std::mutex> lock(mMutex);
+        for(auto iter = mLRU.begin(); iter!=mLRU.end();){
+            if(iter->store==&store){
+                mResidentBytes -= iter->bytes;
+                mEntries.erase(iter->key);
+                iter = mLRU.erase(iter);
+            }else{
+                ++iter;
+            }
+        }
+    }
+    
+    void TileCache::evict(){
+        // The most recently used tile is kept even if it alone exceeds the capacity.
+        while(mCapacityBytes < mResidentBytes && 1 < mLRU.size()){
+            const Entry& entry = mLRU.back();
+            entry.store->release(static_cast<uint32_t>(entry.key & 0xFFFFFFFF));
+            mResidentBytes -= entry.bytes;
+            mEntries.erase(entry.key);
+            mLRU.pop_back();
+            mEvictionEpoch.fetch_add(1, std::memory_order_release);
+        }
+    }
+    
+    void TiledLabelStore::write(const std::string& path, int rows, int cols, const std::function<uint8_t(int y, int x)>& label, int tileSize, uint32_t siteLabels){
+        if(tileSize<minTileSize || (tileSize & (tileSize-1))!=0){
+            BOOST_THROW_EXCEPTION(LocException("tileSize must be a power of two not smaller than " + std::to_string(minTileSize) + "."));
+        }
+        std::shared_ptr<NearestSiteRaster> raster;
+        std::vector<uint32_t> sites;
+        if(siteLabels!=0){
+            raster = std::make_shared<NearestSiteRaster>(rows, cols, [&](int y, int x){
+                uint8_t l = label(y, x);
+                bool isSite = l<32 && (siteLabels & (1u << l))!=0;
+                if(isSite){
+                    sites.push_back((static_cast<uint32_t>(y)<<16) | x);
+                }
+                return isSite;
+            });
+        }
+        
+        std::ofstream ofs(path, std::ios::binary);
+        if(!ofs){
+            BOOST_THROW_EXCEPTION(LocException("Failed to open " + path));
+        }
+        size_t tileBytes = static_cast<size_t>(tileSize)*tileSize;
+        std::vector<char> block(tileBytes, 0);
+        int32_t header[nHeaderValues] = {rows, cols, tileSize, static_cast<int32_t>(siteLabels), static_cast<int32_t>(sites.size())};
+        std::memcpy(block.data(), tilesMagic, sizeof(tilesMagic));
+        std::memcpy(block.data()+sizeof(tilesMagic), header, sizeof(header));
+        ofs.write(block.data(), block.size());
+        
+        int nTilesY = (rows + tileSize - 1)/tileSize;
+        int nTilesX = (cols + tileSize - 1)/tileSize;
+        for(int ty=0; ty<nTilesY; ty++){
+            for(int tx=0; tx<nTilesX; tx++){
+                for(int j=0; j<tileSize; j++){
+                    int y = ty*tileSize + j;
+                    for(int i=0; i<tileSize; i++){
+                        int x = tx*tileSize + i;
+                        block[j*tileSize + i] = (y<rows && x<cols) ? static_cast<char>(label(y, x)) : 0;
+                    }
+                }
+                ofs.write(block.data(), block.size());
+            }
+        }
+        
+        if(raster){
+            std::vector<uint32_t> codes(tileBytes);
+            for(int ty=0; ty<nTilesY; ty++){
+                for(int tx=0; tx<nTilesX; tx++){
+                    for(int j=0; j<tileSize; j++){
+                        int y = ty*tileSize + j;
+                        for(int i=0; i<tileSize; i++){
+                            int x = tx*tileSize + i;
+                            int ySite, xSite;
+                            bool found = y<rows && x<cols && raster->nearest(y, x, ySite, xSite);
+                            codes[j*tileSize + i] = found ? (static_cast<uint32_t>(ySite)<<16) | xSite : noSite;
+                        }
+                    }
+                    ofs.write(reinterpret_cast<const char*>(codes.data()), codes.size()*sizeof(uint32_t));
+                }
+            }
+            ofs.write(reinterpret_cast<const char*>(sites.data()), sites.size()*sizeof(uint32_t));
+        }
+        ofs.close();
+        if(!ofs){
+            BOOST_THROW_EXCEPTION(LocException("Failed to write " + path));
+        }
+    }
+    
+    TiledLabelStore::TiledLabelStore(const std::string& path, TileCache::Ptr cache) : mCache(cache ? cache : TileCache::shared()){
+        static std::atomic<uint32_t> nextId(1);
+        mId = nextId++;
+        
+        int fd = open(path.c_str(), O_RDONLY);
+        if(fd<0){
+            BOOST_THROW_EXCEPTION(LocException("Failed to open " + path));
+        }
+        struct stat st;
+        if(fstat(fd, &st)!=0 || st.st_size < static_cast<off_t>(sizeof(tilesMagic) + nHeaderValues*sizeof(int32_t))){
+            close(fd);
+            BOOST_THROW_EXCEPTION(LocException("Invalid tiled label file " + path));
+        }
+        mMappedBytes = static_cast<size_t>(st.st_size);
+        void* ptr = mmap(nullptr, mMappedBytes, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if(ptr==MAP_FAILED){
+            BOOST_THROW_EXCEPTION(LocException("Failed to map " + path));
+        }
+        mMapped = static_cast<const uint8_t*>(ptr);
+        
+        int32_t header[nHeaderValues];
+        std::memcpy(header, mMapped + sizeof(tilesMagic), sizeof(header));
+        mRows = header[0];
+        mCols = header[1];
+        mTileSize = header[2];
+        mSiteLabels = static_cast<uint32_t>(header[3]);
+        mNSites = static_cast<uint32_t>(header[4]);
+        bool valid = std::memcmp(mMapped, tilesMagic, sizeof(tilesMagic))==0 && 0<=mRows && 0<=mCols
+                    && minTileSize<=mTileSize && (mTileSize & (mTileSize-1))==0;
+        if(valid){
+            mTileShift = 0;
+            while((1 << mTileShift) < mTileSize){
+                mTileShift++;
+            }
+            mTileBytes = static_cast<size_t>(mTileSize)*mTileSize;
+            mNTilesX = (mCols + mTileSize - 1)/mTileSize;
+            int nTilesY = (mRows + mTileSize - 1)/mTileSize;
+            mNTiles = static_cast<uint32_t>(nTilesY*mNTilesX);
+            size_t size = (static_cast<size_t>(mNTiles) + 1)*mTileBytes;
+            if(mSiteLabels!=0){
+                size += mNTiles*mTileBytes*sizeof(uint32_t) + mNSites*sizeof(uint32_t);
+            }
+            valid = size <= mMappedBytes;
+        }
+        if(!valid){
+            munmap(const_cast<uint8_t*>(mMapped), mMappedBytes);
+            BOOST_THROW_EXCEPTION(LocException("Invalid tiled label file " + path));
+        }
+        static const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        if(mTileBytes % pageSize!=0){
+            std::cerr << "TiledLabelStore: tiles of " << path << " (" << mTileBytes << " bytes) are not a multiple of the page size ("
+            << pageSize << " bytes). Only the pages inside tiles are released." << std::endl;
+        }
+    }
+    
+    TiledLabelStore::~TiledLabelStore(){
+        mCache->remove(*this);
+        munmap(const_cast<uint8_t*>(mMapped), mMappedBytes);
+    }
+    
+    int TiledLabelStore::rows() const{
+        return mRows;
+    }
+    
+    int TiledLabelStore::cols() const{
+        return mCols;
+    }
+    
+    int TiledLabelStore::tileSize() const{
+        return mTileSize;
+    }
+    
+    const uint8_t* TiledLabelStore::tile(uint32_t tileIndex) const{
+        // The last tile of the thread is used without locking the cache while it is accessed repeatedly.
+        // It is touched again after any eviction because the eviction may have released it.
+        struct LastTile{
+            uint32_t storeId = 0;
+            uint32_t tileIndex = 0;
+            uint32_t hits = 0;
+            uint64_t epoch = 0;
+        };
+        static thread_local LastTile last;
+        uint64_t epoch = mCache->mEvictionEpoch.load(std::memory_order_acquire);
+        if(last.storeId!=mId || last.tileIndex!=tileIndex || last.epoch!=epoch || (++last.hits & 0xFFFF)==0){
+            mCache->touch(*this, tileIndex);
+            last.storeId = mId;
+            last.tileIndex = tileIndex;
+            last.hits = 0;
+            // Read after touching, which may evict
+            last.epoch = mCache->mEvictionEpoch.load(std::memory_order_acquire);
+        }
+        return mMapped + tileOffset(tileIndex);
+    }
+    
+    size_t TiledLabelStore::tileOffset(uint32_t tileIndex) const{
+        if(tileIndex<mNTiles){
+            return (static_cast<size_t>(tileIndex) + 1)*mTileBytes;
+        }
+        return (static_cast<size_t>(mNTiles) + 1)*mTileBytes + (tileIndex - mNTiles)*tileBytes(tileIndex);
+    }
+    
+    size_t TiledLabelStore::tileBytes(uint32_t tileIndex) const{
+        return tileIndex<mNTiles ? mTileBytes : mTileBytes*sizeof(uint32_t);
+    }
+    
+    void TiledLabelStore::release(uint32_t tileIndex) const{
+        // The mapping is read-only and backed by the file, so released pages are read again on the next access.
+        // The range is rounded inward to whole pages so that pages shared with neighboring tiles are kept.
+        static const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        size_t begin = tileOffset(tileIndex);
+        size_t end = begin + tileBytes(tileIndex);
+        begin = (begin + pageSize - 1)/pageSize*pageSize;
+        end = end/pageSize*pageSize;
+        if(begin < end){
+            madvise(const_cast<uint8_t*>(mMapped + begin), end - begin, MADV_DONTNEED);
+        }
+    }
+    
+    uint8_t TiledLabelStore::getLabel(int y, int x) const{
+        if(y<0 || mRows<=y || x<0 || mCols<=x){
+            return 0;
+        }
+        uint32_t tileIndex = static_cast<uint32_t>((y >> mTileShift)*mNTilesX + (x >> mTileShift));
+        int mask = mTileSize - 1;
+        return tile(tileIndex)[((y & mask) << mTileShift) + (x & mask)];
+    }
+    
+    uint32_t TiledLabelStore::siteLabels() const{
+        return mSiteLabels;
+    }
+    
+    bool TiledLabelStore::nearestSite(int y, int x, int& ySite, int& xSite) const{
+        if(mNSites==0){
+            return false;
+        }
+        uint32_t code = noSite;
+        if(0<=y && y<mRows && 0<=x && x<mCols){
+            uint32_t tileIndex = static_cast<uint32_t>((y >> mTileShift)*mNTilesX + (x >> mTileShift));
+            int mask = mTileSize - 1;
+            const uint32_t* codes = reinterpret_cast<const uint32_t*>(tile(mNTiles + tileIndex));
+            code = codes[((y & mask) << mTileShift) + (x & mask)];
+        }else{
+            // Queries outside the image scan the sites.
+            const uint32_t* sites = reinterpret_cast<const uint32_t*>(mMapped + (static_cast<size_t>(mNTiles) + 1)*mTileBytes
+                                                                      + mNTiles*mTileBytes*sizeof(uint32_t));
+            double dmin = std::numeric_limits<double>::max();
+            for(uint32_t i=0; i<mNSites; i++){
+                double dy = y - static_cast<int>(sites[i]>>16);
+                double dx = x - static_cast<int>(sites[i] & 0xFFFF);
+                double d = dx*dx + dy*dy;
+                if(d < dmin){
+                    dmin = d;
+                    code = sites[i];
+                }
+            }
+        }
+        if(code==noSite){
+            return false;
+        }
+        ySite = static_cast<int>(code>>16);
+        xSite = static_cast<int>(code & 0xFFFF);
+        return true;
+    }
+    
+}
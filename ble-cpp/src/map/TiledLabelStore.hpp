@@ -0,0 +1,141 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef TiledLabelStore_hpp
+#define TiledLabelStore_hpp
+
+#include <stdio.h>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace loc{
+    
+    class TiledLabelStore;
+    
+    /**
+     Bounds the resident memory of the tiles of the TiledLabelStores sharing the cache.
+     Tiles are tracked in least recently used order, and the pages of tiles beyond the capacity are released to the OS.
+     Released tiles are read again from the file when they are accessed.
+     **/
+    class TileCache{
+    public:
+        using Ptr = std::shared_ptr<TileCache>;
+        
+        // Used by the stores opened without a cache
+        static Ptr shared();
+        
+        TileCache& capacityBytes(size_t bytes);
+        size_t capacityBytes() const;
+        size_t residentBytes() const;
+        
+    private:
+        friend class TiledLabelStore;
+        
+        struct Entry{
+            const TiledLabelStore* store;
+            uint64_t key;
+            size_t bytes;
+        };
+        
+        mutable std::mutex mMutex;
+        size_t mCapacityBytes = 256*1024*1024;
+        size_t mResidentBytes = 0;
+        // Advanced whenever tiles are released so that threads holding a tile without locking touch it again.
+        std::atomic<uint64_t> mEvictionEpoch{0};
+        std::list<Entry> mLRU;
+        std::unordered_map<uint64_t, std::list<Entry>::iterator> mEntries;
+        
+        void touch(const TiledLabelStore& store, uint32_t tileIndex);
+        void remove(const TiledLabelStore& store);
+        void evict();
+    };
+    
+    /**
+     Label raster split into square tiles and stored in a file that is memory-mapped.
+     File layout: a header block of one tile size (magic, rows, cols, tile size, site labels, number of sites), then label
+     tiles in row-major order. Tiles are released page by page, so tiles smaller than a page stay resident. Tiles are padded with white at the right and bottom edges.
+     When site labels are given, the nearest-site raster of the pixels having them (see NearestSiteRaster) follows as
+     tiles of 32-bit codes in the same order, then the list of the sites. Its tiles share the TileCache with the labels.
+     **/
+    class TiledLabelStore{
+    public:
+        using Ptr = std::shared_ptr<TiledLabelStore>;
+        
+        static constexpr int defaultTileSize = 256;
+        // The header block must hold the header
+        static constexpr int minTileSize = 8;
+        
+        // Writes a tiled file of rows*cols labels given by label(y, x).
+        // siteLabels: bit mask of the labels whose nearest-site raster is stored (0: none)
+        static void write(const std::string& path, int rows, int cols, const std::function<uint8_t(int y, int x)>& label,
+                          int tileSize = defaultTileSize, uint32_t siteLabels = 0);
+        
+        // cache: TileCache::shared() when null
+        TiledLabelStore(const std::string& path, TileCache::Ptr cache = nullptr);
+        ~TiledLabelStore();
+        TiledLabelStore(const TiledLabelStore&) = delete;
+        TiledLabelStore& operator=(const TiledLabelStore&) = delete;
+        
+        int rows() const;
+        int cols() const;
+        int tileSize() const;
+        // Label of the pixel. Pixels outside the raster are labeled 0 (white).
+        uint8_t getLabel(int y, int x) const;
+        
+        // Bit mask of the labels of the stored nearest-site raster (0: none)
+        uint32_t siteLabels() const;
+        // Closest pixel having any of the site labels. Returns false when there is no site.
+        bool nearestSite(int y, int x, int& ySite, int& xSite) const;
+        
+    private:
+        friend class TileCache;
+        
+        TileCache::Ptr mCache;
+        uint32_t mId;
+        int mRows;
+        int mCols;
+        int mTileSize;
+        int mTileShift;
+        int mNTilesX;
+        uint32_t mNTiles;
+        size_t mTileBytes;
+        uint32_t mSiteLabels = 0;
+        uint32_t mNSites = 0;
+        const uint8_t* mMapped = nullptr;
+        size_t mMappedBytes = 0;
+        
+        // Label tiles are indexed from 0 and nearest-site tiles from mNTiles.
+        const uint8_t* tile(uint32_t tileIndex) const;
+        size_t tileOffset(uint32_t tileIndex) const;
+        size_t tileBytes(uint32_t tileIndex) const;
+        void release(uint32_t tileIndex) const;
+    };
+    
+}
+
+#endif /* TiledLabelStore_hpp */
@@ -0,0 +1,257 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#include "WallQueryEngine.hpp"
+#include "LocException.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace loc{
+    
+    namespace{
+        // Bound of the distance between a point and the center of the pixel it is rounded to, plus a margin for rounding errors.
+        constexpr double roundingMargin = 0.7072 + 0.01;
+        
+        // One-dimensional squared Euclidean distance transform (Felzenszwalb and Huttenlocher).
+        void distanceTransform1D(const float* f, int n, float* d, int* v, float* z){
+            const float inf = std::numeric_limits<float>::infinity();
+            int k = 0;
+            v[0] = 0;
+            z[0] = -inf;
+            z[1] = inf;
+            for(int q=1; q<n; q++){
+                float s = ((f[q]+q*(float)q) - (f[v[k]]+v[k]*(float)v[k]))/(2*q - 2*v[k]);
+                while(s <= z[k]){
+                    k--;
+                    s = ((f[q]+q*(float)q) - (f[v[k]]+v[k]*(float)v[k]))/(2*q - 2*v[k]);
+                }
+                k++;
+                v[k] = q;
+                z[k] = s;
+                z[k+1] = inf;
+            }
+            k = 0;
+            for(int q=0; q<n; q++){
+                while(z[k+1] < q){
+                    k++;
+                }
+                d[q] = (q-v[k])*(float)(q-v[k]) + f[v[k]];
+            }
+        }
+    }
+    
+    WallQueryEngine::WallQueryEngine(const ImageHolder& image) : mImage(image){
+        mRows = image.rows();
+        mCols = image.cols();
+        computeFields();
+    }
+    
+    static const char fieldsMagic[4] = {'W', 'Q', 'E', '1'};
+    
+    WallQueryEngine::WallQueryEngine(const ImageHolder& image, std::istream& fields) : mImage(image){
+        mRows = image.rows();
+        mCols = image.cols();
+        char magic[4];
+        int32_t size[3];
+        fields.read(magic, sizeof(magic));
+        fields.read(reinterpret_cast<char*>(size), sizeof(size));
+        if(!fields || std::memcmp(magic, fieldsMagic, sizeof(magic))!=0
+           || size[0]!=mRows || size[1]!=mCols || size[2]!=normalBandPixels){
+            BOOST_THROW_EXCEPTION(LocException("Wall fields do not match the image."));
+        }
+        size_t n = static_cast<size_t>(mRows)*mCols;
+        mClearance.resize(n);
+        mNormal.resize(n);
+        fields.read(reinterpret_cast<char*>(mClearance.data()), n);
+        fields.read(reinterpret_cast<char*>(mNormal.data()), n);
+        if(!fields){
+            BOOST_THROW_EXCEPTION(LocException("Truncated wall fields."));
+        }
+    }
+    
+    void WallQueryEngine::writeFields(std::ostream& os) const{
+        int32_t size[3] = {mRows, mCols, normalBandPixels};
+        os.write(fieldsMagic, sizeof(fieldsMagic));
+        os.write(reinterpret_cast<const char*>(size), sizeof(size));
+        os.write(reinterpret_cast<const char*>(mClearance.data()), mClearance.size());
+        os.write(reinterpret_cast<const char*>(mNormal.data()), mNormal.size());
+    }
+    
+    int WallQueryEngine::rows() const{
+        return mRows;
+    }
+    
+    int WallQueryEngine::cols() const{
+        return mCols;
+    }
+    
+    void WallQueryEngine::computeFields(){
+        size_t size = static_cast<size_t>(mRows)*mCols;
+        mClearance.assign(size, 0);
+        mNormal.assign(size, 0);
+        if(size==0){
+            return;
+        }
+        // Squared distances are large but finite for images without walls so that they saturate below.
+        const float far = 1.0e10f;
+        std::vector<float> grid(size);
+        for(int y=0; y<mRows; y++){
+            for(int x=0; x<mCols; x++){
+                grid[y*(size_t)mCols + x] = mImage.getLabel(y, x)==label::black ? 0.0f : far;
+            }
+        }
+        int n = std::max(mRows, mCols);
+        std::vector<float> f(n), d(n), z(n+1);
+        std::vector<int> v(n);
+        // Columns
+        for(int x=0; x<mCols; x++){
+            for(int y=0; y<mRows; y++){
+                f[y] = grid[y*(size_t)mCols + x];
+            }
+            distanceTransform1D(f.data(), mRows, d.data(), v.data(), z.data());
+            for(int y=0; y<mRows; y++){
+                grid[y*(size_t)mCols + x] = d[y];
+            }
+        }
+        // Rows
+        for(int y=0; y<mRows; y++){
+            float* row = &grid[y*(size_t)mCols];
+            std::copy(row, row+mCols, f.begin());
+            distanceTransform1D(f.data(), mCols, d.data(), v.data(), z.data());
+            uint8_t* clearance = &mClearance[y*(size_t)mCols];
+            for(int x=0; x<mCols; x++){
+                row[x] = std::sqrt(d[x]);
+                clearance[x] = static_cast<uint8_t>(std::min(255.0f, std::floor(row[x])));
+            }
+        }
+        // Normals from the Sobel gradient of the distance field
+        auto D = [&](int y, int x){
+            y = std::min(std::max(y, 0), mRows-1);
+            x = std::min(std::max(x, 0), mCols-1);
+            return grid[y*(size_t)mCols + x];
+        };
+        for(int y=0; y<mRows; y++){
+            for(int x=0; x<mCols; x++){
+                if(normalBandPixels < D(y, x)){
+                    continue;
+                }
+                double gx = (D(y-1,x+1) + 2*D(y,x+1) + D(y+1,x+1)) - (D(y-1,x-1) + 2*D(y,x-1) + D(y+1,x-1));
+                double gy = (D(y+1,x-1) + 2*D(y+1,x) + D(y+1,x+1)) - (D(y-1,x-1) + 2*D(y-1,x) + D(y-1,x+1));
+                if(gx*gx + gy*gy < 1.0e-6){
+                    continue;
+                }
+                double angle = std::atan2(gy, gx); // [-pi, pi]
+                int code = 1 + static_cast<int>(std::lround((angle + M_PI)/(2*M_PI)*254));
+                mNormal[y*(size_t)mCols + x] = static_cast<uint8_t>(std::min(255, std::max(1, code)));
+            }
+        }
+    }
+    
+    bool WallQueryEngine::wallNormal(int y, int x, double& nx, double& ny) const{
+        if(y<0 || mRows<=y || x<0 || mCols<=x){
+            return false;
+        }
+        uint8_t code = mNormal[y*(size_t)mCols + x];
+        if(code==0){
+            return false;
+        }
+        double angle = (code - 1)/254.0*2*M_PI - M_PI;
+        nx = std::cos(angle);
+        ny = std::sin(angle);
+        return true;
+    }
+    
+    uint8_t WallQueryEngine::clearance(int y, int x) const{
+        if(0<=y && y<mRows && 0<=x && x<mCols){
+            return mClearance[y*(size_t)mCols + x];
+        }
+        return 0;
+    }
+    
+    double WallQueryEngine::walkSamples(double x0, double y0, double x1, double y1, bool stopsAtEscalator) const{
+        double norm = std::sqrt((x1-x0)*(x1-x0) + (y1-y0)*(y1-y0));
+        int norm_int = static_cast<int>(norm) + 1;
+        double dx = (x1-x0)/norm_int;
+        double dy = (y1-y0)/norm_int;
+        double x = x0;
+        double y = y0;
+        int count = 0;
+        while(count<=norm_int){
+            uint8_t l = mImage.getLabel(static_cast<int>(std::round(y)), static_cast<int>(std::round(x)));
+            if(l==label::black || (stopsAtEscalator && l==label::lime)){
+                return ((double)count-1)/norm_int;
+            }
+            x+=dx;
+            y+=dy;
+            count++;
+        }
+        return ((double)count-1)/norm_int;
+    }
+    
+    double WallQueryEngine::wallCrossingRatio(double x0, double y0, double x1, double y1, bool stopsAtEscalator) const{
+        if(stopsAtEscalator){
+            return walkSamples(x0, y0, x1, y1, stopsAtEscalator);
+        }
+        double norm = std::sqrt((x1-x0)*(x1-x0) + (y1-y0)*(y1-y0));
+        int norm_int = static_cast<int>(norm) + 1;
+        
+        int xStart = static_cast<int>(std::round(x0));
+        int yStart = static_cast<int>(std::round(y0));
+        bool startIsInside = 0<=yStart && yStart<mRows && 0<=xStart && xStart<mCols;
+        // Early accept: every sample is rounded to a pixel closer to the start pixel than its clearance.
+        if(startIsInside && norm + 2*roundingMargin < clearance(yStart, xStart)){
+            return 1.0;
+        }
+        
+        double dx = (x1-x0)/norm_int;
+        double dy = (y1-y0)/norm_int;
+        double step = norm/norm_int;
+        double x = x0;
+        double y = y0;
+        int count = 0;
+        while(count<=norm_int){
+            int yInt = static_cast<int>(std::round(y));
+            int xInt = static_cast<int>(std::round(x));
+            int jump = 1;
+            if(0<=yInt && yInt<mRows && 0<=xInt && xInt<mCols){
+                uint8_t c = mClearance[yInt*(size_t)mCols + xInt];
+                if(c==0){
+                    return ((double)count-1)/norm_int;
+                }
+                // Samples closer than the clearance (minus the rounding of both samples) cannot be on a wall.
+                if(0 < step){
+                    jump = std::max(1, static_cast<int>(std::ceil((c - 2*roundingMargin)/step)));
+                }
+            }
+            // Advance sample by sample to reproduce the positions of the per-pixel walk.
+            for(int i=0; i<jump && count<=norm_int; i++){
+                x+=dx;
+                y+=dy;
+                count++;
+            }
+        }
+        return ((double)count-1)/norm_int;
+    }
+    
+}
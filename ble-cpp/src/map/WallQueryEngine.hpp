@@ -0,0 +1,82 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef WallQueryEngine_hpp
+#define WallQueryEngine_hpp
+
+#include <stdio.h>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "ImageHolder.hpp"
+
+namespace loc{
+    
+    /**
+     Answers segment-vs-wall queries on a floor image in local (pixel) coordinates.
+     A clearance field (Euclidean distance from each pixel to the closest wall pixel, saturated at 255) is computed once.
+     A segment is accepted without traversal when it is shorter than the clearance of its start pixel, and otherwise
+     traversed with steps as long as the clearance at the current sample allows.
+     Results are identical to the per-pixel walk of FloorMap::wallCrossingRatio.
+     A wall normal field (gradient direction of the distance field, quantized to 8 bits) is also precomputed for
+     pixels within normalBandPixels of a wall.
+     **/
+    class WallQueryEngine{
+    public:
+        using Ptr = std::shared_ptr<WallQueryEngine>;
+        
+        static constexpr int normalBandPixels = 16;
+        
+        WallQueryEngine(const ImageHolder& image);
+        // Restores the fields written by writeFields instead of computing them.
+        WallQueryEngine(const ImageHolder& image, std::istream& fields);
+        ~WallQueryEngine() = default;
+        
+        void writeFields(std::ostream& os) const;
+        
+        int rows() const;
+        int cols() const;
+        // Clearance in pixels. 0 for wall pixels and pixels outside the image.
+        uint8_t clearance(int y, int x) const;
+        
+        // Ratio of the segment from (x0, y0) to (x1, y1) that can be moved before hitting a wall.
+        // When stopsAtEscalator is true, escalator pixels are also treated as walls.
+        double wallCrossingRatio(double x0, double y0, double x1, double y1, bool stopsAtEscalator) const;
+        
+        // Unit vector pointing away from the closest wall in pixel coordinates. Returns false when the pixel has no normal.
+        bool wallNormal(int y, int x, double& nx, double& ny) const;
+        
+    private:
+        ImageHolder mImage;
+        int mRows;
+        int mCols;
+        std::vector<uint8_t> mClearance;
+        std::vector<uint8_t> mNormal; // 0: no normal, 1-255: quantized angle
+        
+        void computeFields();
+        double walkSamples(double x0, double y0, double x1, double y1, bool stopsAtEscalator) const;
+    };
+    
+}
+
+#endif /* WallQueryEngine_hpp */
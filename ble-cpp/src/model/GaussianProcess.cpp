@@ -172,8 +172,16 @@ namespace loc{
     }
     
     std::vector<double> GaussianProcess::predict(double x[], const std::vector<int>& indices) const{
+        std::vector<double> ypreds(indices.size());
+        predict(x, indices.data(), indices.size(), ypreds.data());
+        return ypreds;
+    }
+    
+    void GaussianProcess::predict(double x[], const int indices[], size_t m, double ypreds[]) const{
         Eigen::VectorXd kstar = computeKstar(x);
-        return predict(kstar, indices);
+        for(size_t i=0; i<m; i++){
+            ypreds[i] = Weights_.col(indices[i]).dot(kstar);
+        }
     }
     
     std::vector<double> GaussianProcess::predict(const Eigen::VectorXd& kstar, const std::vector<int>& indices) const{
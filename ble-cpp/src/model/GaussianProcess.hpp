@@ -102,6 +102,8 @@ namespace loc{
         
         virtual double predict(double x[], int index);
         virtual std::vector<double> predict(double x[], const std::vector<int>& indices) const;
+        // Writes predictions for m indices into ypreds.
+        virtual void predict(double x[], const int indices[], size_t m, double ypreds[]) const;
         virtual std::vector<double> predict(const Eigen::VectorXd& kstar, const std::vector<int>& indices) const;
         virtual Eigen::VectorXd predictVarianceF(double x[]) const;
         virtual Eigen::VectorXd predictVarianceF(const Eigen::VectorXd& kstar) const;
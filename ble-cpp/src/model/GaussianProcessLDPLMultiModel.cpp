@@ -38,8 +38,7 @@ namespace loc{
         return *this;
     }
     
-    /*
-    void ITUModelFunction::transformFeature(const Location& stateReceiver, const Location& stateTransmitter, double feats[ndim_]) const{
+    void ITUModelFunction::transformFeature(const Location& stateReceiver, const Location& stateTransmitter, double feats[]) const{
         
         double distOffsetTmp = distanceOffset_;
         double dist = Location::distance(stateReceiver, stateTransmitter, distOffsetTmp);
@@ -56,23 +55,10 @@ namespace loc{
             feats[3] = -1.0;
         }
     }
-    */
     
     std::vector<double> ITUModelFunction::transformFeature(const Location& stateReceiver, const Location& stateTransmitter) const{
         std::vector<double> feats(ndim_);
-        double distOffsetTmp = distanceOffset_;
-        double dist = Location::distance(stateReceiver, stateTransmitter, distOffsetTmp);
-        double floorDiff = Location::floorDifference(stateReceiver, stateTransmitter);
-        
-        feats[0] = -10.0*log10(dist);
-        feats[1] = 1.0;
-        if(floorDiff<1){
-            feats[2] = 0.0;
-            feats[3] = 0.0;
-        }else{
-            feats[2] = -floorDiff;
-            feats[3] = -1.0;
-        }
+        transformFeature(stateReceiver, stateTransmitter, feats.data());
         return feats;
     }
     
@@ -515,28 +501,41 @@ namespace loc{
     }
     
     template<class Tstate, class Tinput>
-    std::map<long, NormalParameter>  GaussianProcessLDPLMultiModel<Tstate, Tinput>::predict(const Tstate& state, const Tinput& input) const{
+    void GaussianProcessLDPLMultiModel<Tstate, Tinput>::prepareBuffers(const Tinput& input, PredictionBuffers& buffers) const{
+        buffers.indices.clear();
+        for(auto iter=input.begin(); iter!=input.end(); iter++){
+            auto itr = mBeaconIdIndexMap.find(iter->id());
+            if(itr!=mBeaconIdIndexMap.end()){
+                buffers.indices.push_back(itr->second);
+            }
+        }
+        buffers.dypreds.resize(buffers.indices.size());
+        buffers.rssiStats.resize(buffers.indices.size());
+    }
+    
+    template<class Tstate, class Tinput>
+    void GaussianProcessLDPLMultiModel<Tstate, Tinput>::predictKnownBeacons(const Tstate& state, const Tinput& input, PredictionBuffers& buffers) const{
         //Assuming Tinput = Beacons
-        std::map<long, NormalParameter> beaconIdRssiStatsMap;
-        
-        std::vector<double> xvec = MLAdapter::locationToVec(state);
-        std::vector<int> indices = extractKnownBeaconIndices(input);
-        std::vector<double> dypreds = mGP->predict(xvec.data(), indices);
+        double xvec[] = {state.x(), state.y(), state.z(), state.floor()};
+        const auto& indices = buffers.indices;
+        const double* dypreds = buffers.dypreds.data();
+        NormalParameter* rssiStats = buffers.rssiStats.data();
+        mGP->predict(xvec, indices.data(), indices.size(), buffers.dypreds.data());
         
         int idx_local=0;
         for(auto iter=input.begin(); iter!=input.end(); iter++){
-            auto b = *iter;
-            long id = b.id();
+            long id = iter->id();
             // RSSI of known beacons are predicted by a model.
             if(mBeaconIdIndexMap.count(id)==1){
-                int idx_global = mBeaconIdIndexMap.at(id);
+                int idx_global = indices[idx_local];
                 const BLEBeacon& bleBeacon = mBLEBeacons.at(idx_global);
                 
                 const auto& ituModel = mITUModelMap.at(id);
-                const auto& features = ituModel.transformFeature(state, bleBeacon);
+                double features[ITUModelFunction::ndim_];
+                ituModel.transformFeature(state, bleBeacon, features);
                 const auto& params = mITUParameters.at(idx_global);
-                double mean = ituModel.predict(params, features);
-                double dypred = dypreds.at(idx_local);
+                double mean = ituModel.predict(params.data(), features);
+                double dypred = dypreds[idx_local];
                 
                 double ypred = mean + dypred;
                 double stdev = mRssiStandardDeviations[idx_global];
@@ -545,12 +544,22 @@ namespace loc{
                     stdev = stdev*mCoeffDiffFloorStdev ;
                 }
                 
-                NormalParameter rssiStats(ypred, stdev);
-                beaconIdRssiStatsMap[id] = rssiStats;
-                
+                rssiStats[idx_local] = NormalParameter(ypred, stdev);
                 idx_local++;
             }
-            
+        }
+    }
+    
+    template<class Tstate, class Tinput>
+    std::map<long, NormalParameter>  GaussianProcessLDPLMultiModel<Tstate, Tinput>::predict(const Tstate& state, const Tinput& input) const{
+        std::map<long, NormalParameter> beaconIdRssiStatsMap;
+        
+        MonotonicArena::Mark mark(this->activeArena());
+        PredictionBuffers buffers(this->activeArena());
+        prepareBuffers(input, buffers);
+        predictKnownBeacons(state, input, buffers);
+        for(size_t i=0; i<buffers.indices.size(); i++){
+            beaconIdRssiStatsMap[mBLEBeacons.at(buffers.indices[i]).id()] = buffers.rssiStats[i];
         }
         return beaconIdRssiStatsMap;
     }
@@ -558,25 +567,43 @@ namespace loc{
     
     template<class Tstate, class Tinput>
     double GaussianProcessLDPLMultiModel<Tstate, Tinput>::computeLogLikelihood(const Tstate& state, const Tinput& input){
-        std::vector<double> values = this->computeLogLikelihoodRelatedValues(state, input);
-        return values.at(0);
+        // Single states are evaluated many times within one update (e.g. by the Metropolis sampler),
+        // so their buffers are rewound instead of accumulating in the arena.
+        MonotonicArena::Mark mark(this->activeArena());
+        PredictionBuffers buffers(this->activeArena());
+        prepareBuffers(input, buffers);
+        double values[nRelatedValues];
+        computeLogLikelihoodRelatedValues(state, input, buffers, values);
+        return values[0];
     }
     
     template<class Tstate, class Tinput>
     std::vector<double> GaussianProcessLDPLMultiModel<Tstate, Tinput>::computeLogLikelihoodRelatedValues(const Tstate& state, const Tinput& input){
+        MonotonicArena::Mark mark(this->activeArena());
+        PredictionBuffers buffers(this->activeArena());
+        prepareBuffers(input, buffers);
+        if(buffers.indices.size()==0){
+            std::cout << "ObservationModel does not know the input data." << std::endl;
+        }
+        std::vector<double> values(nRelatedValues);
+        computeLogLikelihoodRelatedValues(state, input, buffers, values.data());
+        return values;
+    }
+    
+    template<class Tstate, class Tinput>
+    void GaussianProcessLDPLMultiModel<Tstate, Tinput>::computeLogLikelihoodRelatedValues(const Tstate& state, const Tinput& input, PredictionBuffers& buffers, double values[]) const{
         //Assuming Tinput = Beacons
         
-        std::vector<double> returnValues(4); // logLikelihood, mahalanobisDistance, #knownBeacons, #unknownBeacons
+        predictKnownBeacons(state, input, buffers);
+        const NormalParameter* rssiStats = buffers.rssiStats.data();
         
-        auto beaconIdRssiStatsMap = this->predict(state, input);
+        size_t countKnown = buffers.indices.size();
+        size_t countUnknown = input.size() - countKnown;
         
-        std::vector<int> indices = extractKnownBeaconIndices(input);
-        
-        size_t countKnown = indices.size();
-        size_t countUnknown = input.size() - indices.size();
-
-        if(countKnown==0){
-            std::cout << "ObservationModel does not know the input data." << std::endl;
+        double rssiBias = 0;
+        const State* pState = dynamic_cast<const State*>(&state);
+        if(pState){
+            rssiBias = pState->rssiBias();
         }
         
         double jointLogLL = 0;
@@ -584,20 +611,14 @@ namespace loc{
         int i=0;
         for(auto iter=input.begin(); iter!=input.end(); iter++){
             const Beacon& b = *iter;
-            double rssi = b.rssi();
-            
-            const State* pState = dynamic_cast<const State*>(&state);
-            if(pState){
-                double rssiBias = pState->rssiBias();
-                rssi = rssi - rssiBias;
-            }
+            double rssi = b.rssi() - rssiBias;
             long id = b.id();
             
             // RSSI of known beacons are predicted by a model.
             if(mBeaconIdIndexMap.count(id)==1){
-                auto rssiStats = beaconIdRssiStatsMap[id];
-                double ypred = rssiStats.mean();
-                double stdev = rssiStats.stdev();
+                const auto& stats = rssiStats[i];
+                double ypred = stats.mean();
+                double stdev = stats.stdev();
                 
                 //double logLL = MathUtils::logProbaNormal(rssi, ypred, stdev);
                 double logLL = normFunc(rssi, ypred, stdev);
@@ -621,20 +642,23 @@ namespace loc{
                 sumMahaDist += mahaDist;
             }
         }
-        returnValues[0] = jointLogLL;
-        returnValues[1] = sumMahaDist;
-        returnValues[2] = countKnown;
-        returnValues[3] = countUnknown;
-        
-        return returnValues;
+        values[0] = jointLogLL;
+        values[1] = sumMahaDist;
+        values[2] = countKnown;
+        values[3] = countUnknown;
     }
     
     template<class Tstate, class Tinput>
     std::vector<double> GaussianProcessLDPLMultiModel<Tstate, Tinput>::computeLogLikelihood(const std::vector<Tstate> & states, const Tinput & input) {
         int n = (int) states.size();
         std::vector<double> logLLs(n);
+        
+        PredictionBuffers buffers(this->activeArena());
+        prepareBuffers(input, buffers);
+        double values[nRelatedValues];
         for(int i=0; i<n; i++){
-            logLLs[i] = this->computeLogLikelihood(states.at(i), input);
+            this->computeLogLikelihoodRelatedValues(states.at(i), input, buffers, values);
+            logLLs[i] = values[0];
         }
         return logLLs;
     }
@@ -642,15 +666,37 @@ namespace loc{
     template<class Tstate, class Tinput>
     std::vector<std::vector<double>> GaussianProcessLDPLMultiModel<Tstate, Tinput>::computeLogLikelihoodRelatedValues(const std::vector<Tstate> & states, const Tinput & input) {
         int n = (int) states.size();
-        std::vector<double> logLLs(n);
         
-        std::vector<std::vector<double>> values(n);
+        // Known beacon indices and the prediction buffers are shared by all states.
+        PredictionBuffers buffers(this->activeArena());
+        prepareBuffers(input, buffers);
+        if(buffers.indices.size()==0){
+            std::cout << "ObservationModel does not know the input data." << std::endl;
+        }
+        
+        std::vector<std::vector<double>> values(n, std::vector<double>(nRelatedValues));
         for(int i=0; i<n; i++){
-            values[i] = this->computeLogLikelihoodRelatedValues(states.at(i), input);
+            this->computeLogLikelihoodRelatedValues(states.at(i), input, buffers, values[i].data());
         }
         return values;
     }
     
+    template<class Tstate, class Tinput>
+    void GaussianProcessLDPLMultiModel<Tstate, Tinput>::computeLogLikelihoodRelatedValues(const std::vector<Tstate> & states, const Tinput & input, double logLikelihoods[], double mahalanobisDistances[]) {
+        size_t n = states.size();
+        PredictionBuffers buffers(this->activeArena());
+        prepareBuffers(input, buffers);
+        if(buffers.indices.size()==0){
+            std::cout << "ObservationModel does not know the input data." << std::endl;
+        }
+        double values[nRelatedValues];
+        for(size_t i=0; i<n; i++){
+            this->computeLogLikelihoodRelatedValues(states[i], input, buffers, values);
+            logLikelihoods[i] = values[0];
+            mahalanobisDistances[i] = values[1];
+        }
+    }
+    
     template<class Tstate, class Tinput>
     GaussianProcessLDPLMultiModel<Tstate, Tinput>& GaussianProcessLDPLMultiModel<Tstate, Tinput>::fillsUnknownBeaconRssi(bool fills){
         mFillsUnknownBeaconRssi = fills;
@@ -56,7 +56,7 @@ namespace loc{
         int ndim(){return ndim_;}
         
         ITUModelFunction& distanceOffset(double distanceOffset);
-        //void transformFeature(const Location& stateReceiver, const Location& stateTransmitter, double features[]) const;
+        void transformFeature(const Location& stateReceiver, const Location& stateTransmitter, double features[]) const;
         std::vector<double> transformFeature(const Location& stateReceiver, const Location& stateTransmitter) const;
         double predict(const double parameters[], const double features[]) const;
         double predict(const std::vector<double>& parameters, const std::vector<double>& features) const;
@@ -116,6 +116,21 @@ namespace loc{
         std::vector<double> computeRssiStandardDeviations(Samples samples);
         std::vector<int> extractKnownBeaconIndices(const Tinput& beacons) const;
         
+        // Buffers shared by the states evaluated for one input. Backed by the arena when it is active.
+        struct PredictionBuffers{
+            ArenaVector<int> indices; // known beacon indices in the order of input
+            ArenaVector<double> dypreds;
+            ArenaVector<NormalParameter> rssiStats;
+            PredictionBuffers(MonotonicArena* arena)
+            : indices(ArenaAllocator<int>(arena)), dypreds(ArenaAllocator<double>(arena)), rssiStats(ArenaAllocator<NormalParameter>(arena)){}
+        };
+        static const int nRelatedValues = 4; // logLikelihood, mahalanobisDistance, #knownBeacons, #unknownBeacons
+        
+        void prepareBuffers(const Tinput& input, PredictionBuffers& buffers) const;
+        // Predicts RSSI statistics of known beacons (in the order of input) into buffers.rssiStats.
+        void predictKnownBeacons(const Tstate& state, const Tinput& input, PredictionBuffers& buffers) const;
+        void computeLogLikelihoodRelatedValues(const Tstate& state, const Tinput& input, PredictionBuffers& buffers, double values[]) const;
+        
         friend class GaussianProcessLDPLMultiModelTrainer<Tstate, Tinput>;
         int version = 2;
         GPType gpType = GPNORMAL;
@@ -141,6 +156,7 @@ namespace loc{
         
         std::vector<double> computeLogLikelihoodRelatedValues(const Tstate& state, const Tinput& input);
         std::vector<std::vector<double>> computeLogLikelihoodRelatedValues(const std::vector<Tstate> & states, const Tinput& input) override;
+        void computeLogLikelihoodRelatedValues(const std::vector<Tstate> & states, const Tinput& input, double logLikelihoods[], double mahalanobisDistances[]) override;
         
         GaussianProcessLDPLMultiModel& fillsUnknownBeaconRssi(bool fills);
         bool fillsUnknownBeaconRssi() const;
@@ -137,6 +137,13 @@ namespace loc{
         
         //TODO change return type: Eigen::VectorXd would be better
         std::vector<double> predict(double x[], const std::vector<int>& indices) const
+        {
+            std::vector<double> ypreds(indices.size());
+            predict(x, indices.data(), indices.size(), ypreds.data());
+            return ypreds;
+        }
+        
+        void predict(double x[], const int indices[], size_t m, double ypreds[]) const
         {
             const size_t M = 3;
             const size_t n = centers_.size();
@@ -150,27 +157,24 @@ namespace loc{
             //indices of k-nearest (=top-k weight) neigbors
             std::vector<size_t> neighbors = top_k(weights, std::min(M, n));
             
-            Eigen::VectorXd sum_wy = Eigen::VectorXd::Zero(indices.size());
+            Eigen::Map<Eigen::VectorXd> y_hat(ypreds, m);
+            Eigen::VectorXd y(m);
+            y_hat.setZero();
             double sum_w = 0.0;
-            for (auto m : neighbors) {
-                double w = weights.at(m);
-                std::vector<double> tmp = LGPs_.at(m).predict(x, indices);
-                Eigen::VectorXd y = Eigen::Map<Eigen::VectorXd>(tmp.data(), indices.size());
-                sum_wy += w * y;
+            for (auto k : neighbors) {
+                double w = weights.at(k);
+                LGPs_.at(k).predict(x, indices, m, y.data());
+                y_hat += w * y;
                 sum_w  += w;
             }
             
-            Eigen::VectorXd y_hat = sum_wy;
             if (sum_w > MIN_DENOMINATOR) {
                 y_hat /= sum_w;
             } else {
-                std::vector<double> top1ypred = LGPs_.at(neighbors.at(0)).predict(x, indices);
-                y_hat = Eigen::Map<Eigen::VectorXd>(top1ypred.data(), indices.size());
+                LGPs_.at(neighbors.at(0)).predict(x, indices, m, ypreds);
 //                std::cout << "WARN: sum_w~=0 in predict() with " << n << " LGPs"
 //                          << " >> predicted only with the nearest local model."<< std::endl;
             }
-            std::vector<double> ypreds(y_hat.data(), y_hat.data() + indices.size());
-            return ypreds;
         }
 
         /**
@@ -29,6 +29,7 @@
 #include <vector>
 
 #include "Location.hpp"
+#include "MonotonicArena.hpp"
 
 namespace loc{
 
@@ -43,6 +44,31 @@ public:
     virtual std::vector<double> computeLogLikelihood(const std::vector<Tstate> & states, const Tinput & input) = 0;
     
     virtual std::vector<std::vector<double>> computeLogLikelihoodRelatedValues(const std::vector<Tstate> & states, const Tinput& input) = 0;
+    
+    // Writes the log-likelihood and the Mahalanobis distance of each state into caller-owned arrays.
+    virtual void computeLogLikelihoodRelatedValues(const std::vector<Tstate> & states, const Tinput& input, double logLikelihoods[], double mahalanobisDistances[]){
+        std::vector<std::vector<double>> values = computeLogLikelihoodRelatedValues(states, input);
+        for(size_t i=0; i<states.size(); i++){
+            logLikelihoods[i] = values[i].at(0);
+            mahalanobisDistances[i] = values[i].at(1);
+        }
+    }
+    
+    // Arena for transient data. The owner of the arena resets it after each input.
+    void arena(MonotonicArena::Ptr arena){
+        mArena = arena;
+    }
+    MonotonicArena::Ptr arena() const{
+        return mArena;
+    }
+    
+protected:
+    MonotonicArena::Ptr mArena;
+    
+    // Arena usable by the calling thread, or nullptr to allocate from the heap.
+    MonotonicArena* activeArena() const{
+        return (mArena && mArena->isActiveInCurrentThread()) ? mArena.get() : nullptr;
+    }
 
 };
 
@@ -42,12 +42,42 @@ namespace loc{
     
     std::vector<State> PoseRandomWalker::predict(std::vector<State> states, SystemModelInput input){
         std::vector<State> statesPredicted(states.size());
+        PredictionScope<State, SystemModelInput> scope(*this, states, input);
         for(int i=0; i<states.size(); i++){
             statesPredicted[i]= predict(states[i], input);
         }
         return statesPredicted;
     }
     
+    void PoseRandomWalker::startPredictions(const std::vector<State>& states, const SystemModelInput& input){
+        if(input.hasAggregatedMotion()){
+            nStepsHeld = input.nSteps();
+            yawHeld = input.yaw();
+            walkingRateHeld = input.walkingRate();
+        }else{
+            nStepsHeld = mProperty->pedometer()->getNSteps();
+            yawHeld = mProperty->orientationMeter()->getYaw();
+            walkingRateHeld = 1.0;
+        }
+        holdsSensorValues = true;
+    }
+    
+    void PoseRandomWalker::endPredictions(const std::vector<State>& states, const SystemModelInput& input){
+        holdsSensorValues = false;
+    }
+    
+    double PoseRandomWalker::nSteps(){
+        return holdsSensorValues ? nStepsHeld : mProperty->pedometer()->getNSteps();
+    }
+    
+    double PoseRandomWalker::yaw(){
+        return holdsSensorValues ? yawHeld : mProperty->orientationMeter()->getYaw();
+    }
+    
+    double PoseRandomWalker::walkingRate(){
+        return holdsSensorValues ? walkingRateHeld : 1.0;
+    }
+    
     State PoseRandomWalker::predict(State state, SystemModelInput input){
         
         //long timestamp = input.timestamp;
@@ -55,47 +85,66 @@ namespace loc{
         double dTime = (input.timestamp()-input.previousTimestamp())/(1000.0); //[s] Difference in time
         
         double movLevel = movingLevel();
-        double nSteps = mProperty->pedometer()->getNSteps();
-        double yaw = mProperty->orientationMeter()->getYaw();
+        double nSteps = this->nSteps();
+        double yaw = this->yaw();
         
         //std::cout << "predict: dTime=" << dTime << ", nSteps=" << nSteps << std::endl;
         
+        // When sensor intervals are merged into one prediction, the noise terms are scaled to follow the per-interval predictions.
+        bool updatesState = nSteps>0 || mProperty->doesUpdateWhenStopping();
+        int nIntervals = input.nIntervals();
+        double dInterval = dTime/nIntervals;
+        double nUpdates = mProperty->doesUpdateWhenStopping() ? nIntervals : std::max(1.0, walkingRate()*nIntervals);
+        double dUpdates = dInterval*std::sqrt(nUpdates);
+        
         // Perturb variables in State
-        if(nSteps>0 || mProperty->doesUpdateWhenStopping() ){
-            state.orientationBias(state.orientationBias() + stateProperty->diffusionOrientationBias()*randomGenerator.nextGaussian()*dTime );
-            state.rssiBias(randomGenerator.nextTruncatedGaussian(state.rssiBias(), stateProperty->diffusionRssiBias()*dTime , stateProperty->minRssiBias(), stateProperty->maxRssiBias()));
+        if(updatesState){
+            state.orientationBias(state.orientationBias() + stateProperty->diffusionOrientationBias()*randomGenerator.nextGaussian()*dUpdates );
+            state.rssiBias(randomGenerator.nextTruncatedGaussian(state.rssiBias(), stateProperty->diffusionRssiBias()*dUpdates , stateProperty->minRssiBias(), stateProperty->maxRssiBias()));
         }
         
-        // Update orientation
+        // Update orientation. The noise drawn at each interval averages out over the merged intervals.
         double previousOrientation = state.orientation();
         double orientationActual = yaw - state.orientationBias();
-        orientationActual += poseProperty->stdOrientation()*randomGenerator.nextGaussian()*dTime;
+        double stdOrientation = poseProperty->stdOrientation()*dInterval;
+        orientationActual += stdOrientation/std::sqrt(nIntervals)*randomGenerator.nextGaussian();
         orientationActual = Pose::normalizeOrientaion(orientationActual);
         state.orientation(orientationActual);
         
         // Reduce velocity when turning
-        double oriDiff = Pose::computeOrientationDifference(previousOrientation, orientationActual);
         double angularVelocityLimit = mProperty->angularVelocityLimit();
+        double oriDiff = Pose::computeOrientationDifference(previousOrientation, orientationActual);
+        if(1 < nIntervals){
+            // Orientation change per merged interval including the orientation noise of two intervals
+            oriDiff = std::sqrt(std::pow(input.yawChange(), 2) + 2.0*stdOrientation*stdOrientation);
+        }
         double turningVelocityRate = std::sqrt(1.0 - std::min(1.0, std::pow(oriDiff/angularVelocityLimit,2)));
         
         // Perturb variables in Pose
         double v = 0.0;
         double nV = state.normalVelocity();
-        if(nSteps >0 || mProperty->doesUpdateWhenStopping()){
-            nV = randomGenerator.nextTruncatedGaussian(state.normalVelocity(),
-                                                          poseProperty->diffusionVelocity(),
-                                                          poseProperty->minVelocity(),
-                                                          poseProperty->maxVelocity());
+        if(updatesState){
+            double nVPrevious = nV;
+            nV = randomGenerator.nextTruncatedGaussian(nVPrevious,
+                                                       poseProperty->diffusionVelocity()*std::sqrt(nUpdates),
+                                                       poseProperty->minVelocity(),
+                                                       poseProperty->maxVelocity());
             state.normalVelocity(nV);
+            if(1 < nUpdates){
+                // Mean of the velocity random walk over the merged intervals given its end point
+                double nVMean = nVPrevious + (nV - nVPrevious)*(nUpdates+1)/(2*nUpdates)
+                + poseProperty->diffusionVelocity()*std::sqrt((nUpdates*nUpdates-1)/(12*nUpdates))*randomGenerator.nextGaussian();
+                nV = std::min(std::max(nVMean, poseProperty->minVelocity()), poseProperty->maxVelocity());
+            }
         }
         
         // Update velocity at the moment
         if(nSteps > 0){
-            v = nV * velocityRate() * turningVelocityRate;
+            v = nV * velocityRate() * turningVelocityRate * walkingRate() * input.headingCoherence();
         }
         if(relativeVelocity()>0){
             v += randomGenerator.nextTruncatedGaussian(relativeVelocity(),
-                                                 poseProperty->diffusionVelocity()*dTime,
+                                                 poseProperty->diffusionVelocity()*dInterval/std::sqrt(nIntervals),
                                                  poseProperty->minVelocity(),
                                                  poseProperty->maxVelocity());
         }
@@ -117,7 +166,7 @@ namespace loc{
         if(isUnderControll){
             return mMovement;
         }else{
-            return mProperty->pedometer()->getNSteps();
+            return nSteps();
         }
     }
     
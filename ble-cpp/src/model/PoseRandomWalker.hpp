@@ -82,6 +82,15 @@ namespace loc{
         StateProperty::Ptr stateProperty = StateProperty::Ptr(new StateProperty);
         PoseRandomWalkerProperty::Ptr mProperty = PoseRandomWalkerProperty::Ptr(new PoseRandomWalkerProperty);
         
+        // Sensor values are read once in startPredictions and held until endPredictions.
+        bool holdsSensorValues = false;
+        double nStepsHeld = 0;
+        double yawHeld = 0;
+        double walkingRateHeld = 1.0;
+        double nSteps();
+        double yaw();
+        double walkingRate();
+        
     public:
         
         PoseRandomWalker() = default;
@@ -93,6 +102,8 @@ namespace loc{
         
         virtual std::vector<State> predict(std::vector<State> poses, SystemModelInput input) override;
         virtual State predict(State state, SystemModelInput input) override;
+        virtual void startPredictions(const std::vector<State>& states, const SystemModelInput& input) override;
+        virtual void endPredictions(const std::vector<State>& states, const SystemModelInput& input) override;
         
         virtual double movingLevel();
     };
@@ -56,12 +56,11 @@ namespace loc{
     template<class Ts, class Tin>
     std::vector<Ts> RandomWalker<Ts, Tin>::predict(std::vector<Ts> locations, Tin input){
         std::vector<Ts> locsNew;
-        this->startPredictions(locations, input);
+        PredictionScope<Ts, Tin> scope(*this, locations, input);
         for(Ts loc: locations){
             Ts locNew = predict(loc, input);
             locsNew.push_back(locNew);
         }
-        this->endPredictions(locations, input);
         return locsNew;
     }
     
@@ -53,7 +53,7 @@ namespace loc{
             
             // Compute velocity rate to reduce velocity when turning
             if(mRWMotionProperty->usesAngularVelocityLimit()){
-                double yaw =  Pose::normalizeOrientaion(mOrientationMeter->getYaw());
+                double yaw =  Pose::normalizeOrientaion(this->yaw());
                 if(!wasYawUpdated){
                     currentTimestamp = t_cur;
                     currentYaw = yaw;
@@ -64,7 +64,7 @@ namespace loc{
                     double previousYaw = Pose::normalizeOrientaion(currentYaw);
                     currentYaw = Pose::normalizeOrientaion(yaw);
                     double oriDiff = Pose::computeOrientationDifference(previousYaw, currentYaw);
-                    double angularVelocity = oriDiff/dt;
+                    double angularVelocity = 1 < input.nIntervals() ? input.angularVelocity() : oriDiff/dt;
                     double angularVelocityLimit = mRWMotionProperty->angularVelocityLimit();
                     turningVelocityRate = std::sqrt(1.0 - std::min(1.0, std::pow(angularVelocity/angularVelocityLimit,2)));
                 }
@@ -120,12 +120,49 @@ namespace loc{
         return *this;
     }
     
+    template<class Ts, class Tin>
+    void RandomWalkerMotion<Ts, Tin>::startPredictions(const std::vector<Ts>& states, const Tin& input){
+        const auto& pedometer = mRWMotionProperty->pedometer();
+        const auto& orientationMeter = mRWMotionProperty->orientationMeter();
+        if(input.hasAggregatedMotion()){
+            nStepsHeld = input.nSteps();
+            yawHeld = input.yaw();
+            walkingRateHeld = input.walkingRate();
+            holdsSensorValues = true;
+        }else if(pedometer && orientationMeter){
+            nStepsHeld = pedometer->getNSteps();
+            yawHeld = orientationMeter->getYaw();
+            walkingRateHeld = 1.0;
+            holdsSensorValues = true;
+        }
+    }
+    
+    template<class Ts, class Tin>
+    void RandomWalkerMotion<Ts, Tin>::endPredictions(const std::vector<Ts>& states, const Tin& input){
+        holdsSensorValues = false;
+    }
+    
+    template<class Ts, class Tin>
+    double RandomWalkerMotion<Ts, Tin>::nSteps(){
+        return holdsSensorValues ? nStepsHeld : mRWMotionProperty->pedometer()->getNSteps();
+    }
+    
+    template<class Ts, class Tin>
+    double RandomWalkerMotion<Ts, Tin>::yaw(){
+        return holdsSensorValues ? yawHeld : mRWMotionProperty->orientationMeter()->getYaw();
+    }
+    
+    template<class Ts, class Tin>
+    double RandomWalkerMotion<Ts, Tin>::walkingRate(){
+        return holdsSensorValues ? walkingRateHeld : 1.0;
+    }
+    
     template<class Ts, class Tin>
     double RandomWalkerMotion<Ts, Tin>::movingLevel(){
         if(isUnderControll){
             return mMovement;
         }else{
-            return mRWMotionProperty->pedometer()->getNSteps();
+            return nSteps();
         }
     }
     
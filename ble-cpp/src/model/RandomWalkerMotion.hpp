@@ -85,6 +85,8 @@ namespace loc{
         using Ptr = std::shared_ptr<RandomWalkerMotion>;
         
         virtual Ts predict(Ts state, Tin input) override;
+        virtual void startPredictions(const std::vector<Ts>& states, const Tin& input) override;
+        virtual void endPredictions(const std::vector<Ts>& states, const Tin& input) override;
         virtual RandomWalkerMotion& setProperty(RandomWalkerMotionProperty::Ptr);
 
     protected:
@@ -94,6 +96,15 @@ namespace loc{
         double currentYaw;
         bool wasYawUpdated = false;
         
+        // Sensor values are read once in startPredictions and held until endPredictions.
+        bool holdsSensorValues = false;
+        double nStepsHeld = 0;
+        double yawHeld = 0;
+        double walkingRateHeld = 1.0;
+        double nSteps();
+        double yaw();
+        double walkingRate();
+        
         virtual double movingLevel();
     };
 }
@@ -26,6 +26,7 @@
 #include <stdio.h>
 #include <vector>
 #include <memory>
+#include <algorithm>
 
 #include "Location.hpp"
 
@@ -35,6 +36,15 @@ class SystemModelInput{
     long timestamp_;
     long previousTimestamp_;
     static constexpr double timeUnit_ = 0.001; // ms to s
+    // Motion sensor values aggregated over the interval when several sensor updates are merged into one prediction.
+    bool hasAggregatedMotion_ = false;
+    double nSteps_ = 0;
+    double yaw_ = 0;
+    double walkingRate_ = 1.0;
+    int nIntervals_ = 1;
+    double headingCoherence_ = 1.0;
+    double yawChange_ = 0;
+    double angularVelocity_ = 0;
         
 public:
     void timestamp(long timestamp){
@@ -54,6 +64,49 @@ public:
     double timeUnit() const{
         return timeUnit_;
     }
+    
+    void aggregatedMotion(double nSteps, double yaw, double walkingRate){
+        hasAggregatedMotion_ = true;
+        nSteps_ = nSteps;
+        yaw_ = yaw;
+        walkingRate_ = walkingRate;
+    }
+    bool hasAggregatedMotion() const{
+        return hasAggregatedMotion_;
+    }
+    double nSteps() const{
+        return nSteps_;
+    }
+    double yaw() const{
+        return yaw_;
+    }
+    // Fraction of the interval in which walking was detected
+    double walkingRate() const{
+        return walkingRate_;
+    }
+    
+    // Statistics of the sensor intervals merged into this input, used to keep the dynamics of per-interval predictions.
+    void mergedIntervals(int nIntervals, double headingCoherence, double yawChange, double angularVelocity){
+        nIntervals_ = std::max(1, nIntervals);
+        headingCoherence_ = headingCoherence;
+        yawChange_ = yawChange;
+        angularVelocity_ = angularVelocity;
+    }
+    int nIntervals() const{
+        return nIntervals_;
+    }
+    // Length of the mean heading vector while walking (1: straight, 0: heading cancels out)
+    double headingCoherence() const{
+        return headingCoherence_;
+    }
+    // Root mean square of the yaw change per merged interval [rad]
+    double yawChange() const{
+        return yawChange_;
+    }
+    // Root mean square of the angular velocity over the merged intervals [rad/s]
+    double angularVelocity() const{
+        return angularVelocity_;
+    }
 };
     
     template<class Ts, class Tin> class SystemModel{
@@ -78,6 +131,24 @@ public:
             // Do nothing in a default method
         }
     }; 
+    
+    // Brackets a batch of predictions with startPredictions and endPredictions,
+    // so that the model does not keep holding sensor values when a prediction throws.
+    template<class Ts, class Tin> class PredictionScope{
+        SystemModel<Ts, Tin>& mSysModel;
+        const std::vector<Ts>& mStates;
+        const Tin& mInput;
+    public:
+        PredictionScope(SystemModel<Ts, Tin>& sysModel, const std::vector<Ts>& states, const Tin& input)
+        : mSysModel(sysModel), mStates(states), mInput(input){
+            mSysModel.startPredictions(mStates, mInput);
+        }
+        ~PredictionScope(){
+            mSysModel.endPredictions(mStates, mInput);
+        }
+        PredictionScope(const PredictionScope&) = delete;
+        PredictionScope& operator=(const PredictionScope&) = delete;
+    };
     /*
      template class SystemModel<Location, Input>;
      */
@@ -198,12 +198,14 @@ namespace loc{
     template<class Tstate, class Tinput>
     SystemModelInBuilding<Tstate, Tinput>& SystemModelInBuilding<Tstate, Tinput>::systemModel(typename SystemModelT::Ptr sysModel){
         mSysModel = sysModel;
+        mSysVelAdj = dynamic_cast<SystemModelVelocityAdjustable*>(mSysModel.get());
+        mSysCtrl = dynamic_cast<SystemModelMovementControllable*>(mSysModel.get());
         return *this;
     }
     
     template<class Tstate, class Tinput>
     SystemModelInBuilding<Tstate, Tinput>::SystemModelInBuilding(typename SystemModelT::Ptr sysModel, Building::Ptr building, SystemModelInBuildingProperty::Ptr property){
-        mSysModel = sysModel;
+        systemModel(sysModel);
         mBuilding = building;
         mProperty = property;
     }
@@ -255,7 +257,7 @@ namespace loc{
                 if(mBuilding->isValidFloor(f_new)){
                     stateNew = Tstate(state);
                     stateNew.floor(f_new);
-                    if(mBuilding->isMovable(stateNew) && mBuilding->isElevator(stateNew)){
+                    if(mBuilding->getLabel(stateNew)==label::labelElevator){
                         break;
                     }
                 }
@@ -302,7 +304,7 @@ namespace loc{
             if(mBuilding->isValidFloor(f_new)){
                 stateNew = Tstate(state);
                 stateNew.floor(f_new);
-                if(mBuilding->isMovable(stateNew) && mBuilding->isEscalator(stateNew)){
+                if(mBuilding->getLabel(stateNew)==label::labelEscalator){
                     break;
                 }
             }
@@ -345,7 +347,7 @@ namespace loc{
             if(mBuilding->isValidFloor(f_new)){
                 stateNew = Tstate(state);
                 stateNew.floor(f_new);
-                if(mBuilding->isMovable(stateNew) && mBuilding->isStair(stateNew)){
+                if(mBuilding->getLabel(stateNew)==label::labelStairs){
                     break;
                 }
             }
@@ -370,20 +372,26 @@ namespace loc{
 
     template<class Tstate, class Tinput>
     Tstate SystemModelInBuilding<Tstate, Tinput>::moveOnFloor(const Tstate& state, Tinput input){
-        if(! mBuilding->isMovable(state)){
+        return moveOnFloor(state, input, mBuilding->getLabel(state));
+    }
+    
+    template<class Tstate, class Tinput>
+    Tstate SystemModelInBuilding<Tstate, Tinput>::moveOnFloor(const Tstate& state, Tinput input, uint8_t labelState){
+        if(labelState==label::labelWall){
             BOOST_THROW_EXCEPTION(LocException("building->isMovable(state) is false"));
         }
         Tstate stateNew(state);
         
-        auto sysVelAdj = std::dynamic_pointer_cast<SystemModelVelocityAdjustable>(mSysModel);
-        auto sysCtrl = std::dynamic_pointer_cast<SystemModelMovementControllable>(mSysModel);
+        bool isEscalatorGroup = labelState==label::labelEscalator || labelState==label::labelEscalatorEnd;
+        auto sysVelAdj = mSysVelAdj;
+        auto sysCtrl = mSysCtrl;
         if(sysVelAdj!=NULL){
              // Change field velocity
-             if(mBuilding->isElevator(state)){
+             if(labelState==label::labelElevator){
                  sysVelAdj->velocityRate(mProperty->velocityRateElevator());
-             }else if(mBuilding->isStair(state)){
+             }else if(labelState==label::labelStairs){
                  sysVelAdj->velocityRate(mProperty->velocityRateStair());
-             }else if(mBuilding->isEscalatorGroup(state)){
+             }else if(isEscalatorGroup){
                  sysVelAdj->velocityRate(mProperty->velocityRateEscalator());
                  sysVelAdj->relativeVelocity(mProperty->relativeVelocityEscalator());
              }else{
@@ -391,7 +399,7 @@ namespace loc{
              }
         }
         if(sysCtrl!=NULL){
-            if(mBuilding->isEscalatorGroup(state)){
+            if(isEscalatorGroup){
                 sysCtrl->forceMove();
             }
         }
@@ -470,7 +478,12 @@ namespace loc{
     
     template<class Tstate, class Tinput>
     Tstate SystemModelInBuilding<Tstate, Tinput>::predict(Tstate state, Tinput input){
-        if(! mBuilding->isMovable(state)){
+        return predict(state, input, mBuilding->getLabel(state));
+    }
+    
+    template<class Tstate, class Tinput>
+    Tstate SystemModelInBuilding<Tstate, Tinput>::predict(Tstate state, Tinput input, uint8_t labelState){
+        if(labelState==label::labelWall){
             BOOST_THROW_EXCEPTION(LocException("building->isMovable(state) == false"));
         }
         try{
@@ -480,21 +493,21 @@ namespace loc{
                 return moveOnFloor(stateTmp, input);
             }
             // Standard move
-            if(mBuilding->isElevator(state)){
+            if(labelState==label::labelElevator){
                 Tstate stateTmp = moveOnElevator(state, input);
                 if(Location::floorDifference(state, stateTmp)==0){
                     return moveOnFloor(stateTmp, input);
                 }else{
                     return stateTmp;
                 }
-            }else if(mBuilding->isEscalator(state)){ // escalator move is not allowed on escalator end
+            }else if(labelState==label::labelEscalator){ // escalator move is not allowed on escalator end
                 State stateTmp = moveOnEscalator(state, input);
                 return moveOnFloor(stateTmp, input);
-            }else if(mBuilding->isStair(state)){
+            }else if(labelState==label::labelStairs){
                 State stateTmp = moveOnStair(state, input);
                 return moveOnFloor(stateTmp, input);
             }else{
-                return moveOnFloor(state, input);
+                return moveOnFloor(state, input, labelState);
             }
         }catch(LocException& ex){
             ex << boost::error_info<struct err_info, std::string>("Failed prediction at a given location (" + static_cast<Location>(state).toString() + ")");
@@ -505,12 +518,13 @@ namespace loc{
     template<class Tstate, class Tinput>
     std::vector<Tstate> SystemModelInBuilding<Tstate, Tinput>::predict(std::vector<Tstate> states, Tinput input){
         std::vector<Tstate> statesPredicted(states.size());
-        mSysModel->startPredictions(states, input);
+        PredictionScope<Tstate, Tinput> scope(*mSysModel, states, input);
+        mLabels.resize(states.size());
+        mBuilding->getLabels(states.data(), states.size(), mLabels.data());
         for(int i=0; i<states.size(); i++){
             Tstate& st = states.at(i);
-            statesPredicted[i] = predict(st, input);
+            statesPredicted[i] = predict(st, input, mLabels[i]);
         }
-        mSysModel->endPredictions(states, input);
         return statesPredicted;
     }
     
@@ -123,16 +123,23 @@ namespace loc{
     private:
         RandomGenerator mRandomGenerator;
         typename SystemModel<Tstate, Tinput>::Ptr mSysModel;
+        // Capabilities of mSysModel resolved once when it is set
+        SystemModelVelocityAdjustable* mSysVelAdj = nullptr;
+        SystemModelMovementControllable* mSysCtrl = nullptr;
         Building::Ptr mBuilding;
         SystemModelInBuildingProperty::Ptr mProperty;
         AltitudeManager::Ptr mAltManager;
+        std::vector<uint8_t> mLabels; // labels of the states in a batched prediction
         
         Tstate moveOnElevator(const Tstate& state, Tinput input);
         Tstate moveOnStair(const Tstate& state, Tinput input);
         Tstate moveOnEscalator(const Tstate& state, Tinput input);
         Tstate moveOnFloor(const Tstate& state, Tinput input);
+        // labelState: map label at the state
+        Tstate moveOnFloor(const Tstate& state, Tinput input, uint8_t labelState);
         Tstate moveOnFloorRetry(const Tstate& state, const Tstate& stateNew,  Tinput input);
         Tstate moveFloorJump(const Tstate& state, Tinput input);
+        Tstate predict(Tstate state, Tinput input, uint8_t labelState);
         
     public:
         
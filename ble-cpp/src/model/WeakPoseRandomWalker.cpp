@@ -35,6 +35,9 @@ namespace loc{
         long t_cur = input.timestamp();
         double dt = (t_cur-t_pre) * input.timeUnit();
         double sqdt = std::sqrt(dt);
+        // Noise drawn independently at each merged sensor interval averages out over the intervals.
+        int nIntervals = input.nIntervals();
+        double sqdtInterval = std::sqrt(dt/nIntervals)/std::sqrt(nIntervals);
         
         if(dt < 0){
             std::cerr << "Inconsistent timestamp found in WeakPoseRandomWalker. Location was not updated." << std::endl;
@@ -42,9 +45,9 @@ namespace loc{
         }
         
         if(mPedometer && mOrientationMeter){
-            double nSteps = mPedometer->getNSteps();
+            double nSteps = RandomWalkerMotion<Ts,Tin>::nSteps();
             double movLevel = RandomWalkerMotion<Ts,Tin>::movingLevel();
-            double yaw = mOrientationMeter->getYaw();
+            double yaw = RandomWalkerMotion<Ts,Tin>::yaw();
             
             if(dt<input.timeUnit()){
                 throw std::runtime_error("Time increment is too small in WeakPoseRandomWalker.");
@@ -67,7 +70,7 @@ namespace loc{
                         BOOST_THROW_EXCEPTION(LocException("current yaw is out of range."));
                     }
                     double oriDiff = Pose::computeOrientationDifference(previousYaw, currentYaw);
-                    double angularVelocity = oriDiff/dt;
+                    double angularVelocity = 1 < nIntervals ? input.angularVelocity() : oriDiff/dt;
                     double angularVelocityLimit = mRWMotionProperty->angularVelocityLimit();
                     turningVelocityRate = std::sqrt(1.0 - std::min(1.0, std::pow(angularVelocity/angularVelocityLimit,2)));
                 }
@@ -125,7 +128,7 @@ namespace loc{
             double orientationActual = yaw - state.orientationBias();
             if(movLevel>0 ){
                 // Add noise to orientation
-                orientationActual = mRandGen->nextWrappedNormal(orientationActual, mPoseProperty->stdOrientation() * sqdt);
+                orientationActual = mRandGen->nextWrappedNormal(orientationActual, mPoseProperty->stdOrientation() * sqdtInterval);
                 if( mRandGen->nextDouble() < wPRWProperty->probabilityOrientationJump() ){
                     orientationActual = Pose::normalizeOrientaion( 2.0 * M_PI * (mRandGen->nextDouble() - 0.5));
                 }
@@ -136,11 +139,11 @@ namespace loc{
             double v = 0.0;
             if(nSteps > 0){
                 double nV = state.normalVelocity();
-                v = nV * velocityRate() * turningVelocityRate;
+                v = nV * velocityRate() * turningVelocityRate * RandomWalkerMotion<Ts,Tin>::walkingRate() * input.headingCoherence();
             }
             if(relativeVelocity() > 0){
                 v += mRandGen->nextTruncatedGaussian(relativeVelocity(),
-                                                     mPoseProperty->diffusionVelocity()*sqdt,
+                                                     mPoseProperty->diffusionVelocity()*sqdtInterval,
                                                      mPoseProperty->minVelocity(),
                                                      mPoseProperty->maxVelocity());
             }
@@ -178,6 +181,7 @@ namespace loc{
     
     template<class Ts, class Tin>
     void WeakPoseRandomWalker<Ts, Tin>::startPredictions(const std::vector<Ts>& states, const Tin& input){
+        RandomWalkerMotion<Ts, Tin>::startPredictions(states, input);
         enabledPredictions = true;
         if(previousTimestampResample==0){
             previousTimestampResample = input.timestamp();
@@ -187,6 +191,7 @@ namespace loc{
     
     template<class Ts, class Tin>
     void WeakPoseRandomWalker<Ts, Tin>::endPredictions(const std::vector<Ts>& states, const Tin& input){
+        RandomWalkerMotion<Ts, Tin>::endPredictions(states, input);
         if(wasFiltered){
             previousTimestampResample = input.timestamp();
         }
@@ -0,0 +1,99 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#include "AliasTable.hpp"
+#include "LocException.hpp"
+#include <algorithm>
+
+namespace loc{
+    
+    AliasTable::AliasTable(const std::vector<double>& weights){
+        if(!reset(weights.data(), weights.size())){
+            BOOST_THROW_EXCEPTION(LocException("The sum of the weights is not positive."));
+        }
+    }
+    
+    bool AliasTable::reset(const double* weights, size_t n){
+        mProbability.clear();
+        mAlias.clear();
+        double sum = 0;
+        for(size_t i=0; i<n; i++){
+            if(weights[i] < 0){
+                BOOST_THROW_EXCEPTION(LocException("Weights must be non-negative."));
+            }
+            sum += weights[i];
+        }
+        if(!(0 < sum)){
+            return false;
+        }
+        mProbability.resize(n);
+        mAlias.resize(n);
+        mScaled.resize(n);
+        mSmall.clear();
+        mLarge.clear();
+        for(size_t i=0; i<n; i++){
+            mScaled[i] = weights[i]*n/sum;
+            if(mScaled[i] < 1.0){
+                mSmall.push_back(static_cast<uint32_t>(i));
+            }else{
+                mLarge.push_back(static_cast<uint32_t>(i));
+            }
+        }
+        while(!mSmall.empty() && !mLarge.empty()){
+            uint32_t s = mSmall.back();
+            mSmall.pop_back();
+            uint32_t l = mLarge.back();
+            mProbability[s] = static_cast<float>(mScaled[s]);
+            mAlias[s] = l;
+            mScaled[l] = (mScaled[l] + mScaled[s]) - 1.0;
+            if(mScaled[l] < 1.0){
+                mLarge.pop_back();
+                mSmall.push_back(l);
+            }
+        }
+        // Remaining entries are 1 up to rounding errors.
+        for(uint32_t l: mLarge){
+            mProbability[l] = 1.0f;
+            mAlias[l] = l;
+        }
+        for(uint32_t s: mSmall){
+            mProbability[s] = 1.0f;
+            mAlias[s] = s;
+        }
+        return true;
+    }
+    
+    size_t AliasTable::size() const{
+        return mProbability.size();
+    }
+    
+    bool AliasTable::empty() const{
+        return mProbability.empty();
+    }
+    
+    size_t AliasTable::sample(double u1, double u2) const{
+        size_t n = mProbability.size();
+        size_t i = std::min(n-1, static_cast<size_t>(u1*n));
+        return u2 < mProbability[i] ? i : mAlias[i];
+    }
+    
+}
@@ -0,0 +1,58 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef AliasTable_hpp
+#define AliasTable_hpp
+
+#include <stdio.h>
+#include <cstdint>
+#include <vector>
+
+namespace loc{
+    
+    /**
+     Walker's alias table (Vose's construction) for drawing indices in proportion to non-negative weights in O(1).
+     **/
+    class AliasTable{
+    public:
+        AliasTable() = default;
+        ~AliasTable() = default;
+        AliasTable(const std::vector<double>& weights);
+        
+        // Rebuilds the table reusing the allocated buffers. Returns false when the sum of the weights is not positive.
+        bool reset(const double* weights, size_t n);
+        size_t size() const;
+        bool empty() const;
+        // u1, u2: uniform random numbers in [0, 1)
+        size_t sample(double u1, double u2) const;
+        
+    private:
+        std::vector<float> mProbability;
+        std::vector<uint32_t> mAlias;
+        std::vector<uint32_t> mSmall;
+        std::vector<uint32_t> mLarge;
+        std::vector<double> mScaled;
+    };
+    
+}
+
+#endif /* AliasTable_hpp */
@@ -54,6 +54,52 @@ std::vector<double> ArrayUtils::computeWeightsFromLogLikelihood(std::vector<doub
     return weights;
 }
 
+double ArrayUtils::updateWeightsFromLogLikelihood(const double logLikelihoods[], double weights[], int n, double alphaWeaken,
+                                                  double& maxLogLikelihood, double& averageLogLikelihood){
+    if(n<=0){
+        maxLogLikelihood = std::numeric_limits<double>::lowest();
+        averageLogLikelihood = 0;
+        return 0;
+    }
+    // Pass 1: statistics of raw log-likelihoods and the online log-sum-exp of the unnormalized posterior weights
+    // w*exp(alphaWeaken*logLL), kept as sum*exp(shift) without taking the log of the prior weights.
+    // The sum is at least the prior weight of the particle at the shift, so it cannot underflow to zero.
+    double maxLogLL = logLikelihoods[0];
+    double sumLogLL = 0;
+    double shift = -std::numeric_limits<double>::infinity();
+    double sum = 0;
+    for(int i=0; i<n; i++){
+        double logLL = logLikelihoods[i];
+        maxLogLL = std::max(maxLogLL, logLL);
+        sumLogLL += logLL;
+        double a = alphaWeaken*logLL;
+        if(!(weights[i]>0) || !(-std::numeric_limits<double>::infinity()<a)){
+            continue;
+        }
+        if(shift<a){
+            sum = sum*std::exp(shift-a) + weights[i];
+            shift = a;
+        }else{
+            sum += weights[i]*std::exp(a-shift);
+        }
+    }
+    maxLogLikelihood = maxLogLL;
+    averageLogLikelihood = sumLogLL/n;
+    if(!(0<sum)){
+        return 0;
+    }
+    
+    // Pass 2: normalized posterior weights and ess = 1/sum(w^2)
+    double invSum = 1.0/sum;
+    double sumSquared = 0;
+    for(int i=0; i<n; i++){
+        double w = weights[i]>0 ? weights[i]*std::exp(alphaWeaken*logLikelihoods[i]-shift)*invSum : 0;
+        weights[i] = w;
+        sumSquared += w*w;
+    }
+    return 1.0/sumSquared;
+}
+
 Eigen::VectorXd ArrayUtils::vectorToEigenVector(std::vector<double> v){
     if(std::numeric_limits<int>::max() < v.size()){
         BOOST_THROW_EXCEPTION(LocException("v.size() is larger than numeric_limits."));
@@ -39,6 +39,13 @@ public:
     
     static std::vector<double> computeWeightsFromLogLikelihood(std::vector<double> logLikelihoods);
     
+    // Fused weight update. Raw logLikelihoods are weakened by alphaWeaken when they are applied and weights (prior weights)
+    // are overwritten by the normalized posterior weights. maxLogLikelihood and averageLogLikelihood are the statistics of
+    // the raw log-likelihoods. Returns the effective sample size, or 0 with weights unchanged when all weights vanish.
+    // Two passes without allocation or std::log.
+    static double updateWeightsFromLogLikelihood(const double logLikelihoods[], double weights[], int n, double alphaWeaken,
+                                                 double& maxLogLikelihood, double& averageLogLikelihood);
+    
     static Eigen::VectorXd vectorToEigenVector(std::vector<double>);
     static std::vector<double> eigenVectorToEigen(Eigen::VectorXd);
 };
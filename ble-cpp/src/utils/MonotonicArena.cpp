@@ -0,0 +1,120 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#include "MonotonicArena.hpp"
+#include <algorithm>
+#include <cstdint>
+
+namespace loc{
+    
+    MonotonicArena::Scope::Scope(MonotonicArena& arena) : mArena(arena){
+        if(mArena.mDepth==0){
+            mArena.mOwner = std::this_thread::get_id();
+        }
+        mArena.mDepth++;
+    }
+    
+    MonotonicArena::Scope::~Scope(){
+        if(mArena.mDepth==1){
+            mArena.reset();
+            mArena.mOwner = std::thread::id();
+        }
+        mArena.mDepth--;
+    }
+    
+    MonotonicArena::Mark::Mark(MonotonicArena* arena) : mArena(arena){
+        if(mArena){
+            mNBlocks = mArena->mBlocks.size();
+            mOffset = mArena->mOffset;
+            mBytesUsed = mArena->mBytesUsed;
+        }
+    }
+    
+    MonotonicArena::Mark::~Mark(){
+        if(mArena && mArena->mBlocks.size()==mNBlocks){
+            mArena->mOffset = mOffset;
+            mArena->mBytesUsed = mBytesUsed;
+        }
+    }
+    
+    MonotonicArena::MonotonicArena(size_t initialBlockSize) : mBlockSize(initialBlockSize){
+    }
+    
+    void MonotonicArena::addBlock(size_t minSize){
+        size_t size = std::max(mBlockSize, minSize);
+        mBlocks.push_back(Block{std::unique_ptr<char[]>(new char[size]), size});
+        mOffset = 0;
+        // Grow geometrically so that a large update needs only a few blocks.
+        mBlockSize = std::max(mBlockSize, size)*2;
+    }
+    
+    void* MonotonicArena::allocate(size_t bytes, size_t alignment){
+        if(bytes==0){
+            bytes = 1;
+        }
+        if(!mBlocks.empty()){
+            Block& block = mBlocks.back();
+            uintptr_t base = reinterpret_cast<uintptr_t>(block.data.get());
+            uintptr_t aligned = (base + mOffset + alignment - 1) & ~(uintptr_t)(alignment - 1);
+            size_t offsetNew = (aligned - base) + bytes;
+            if(offsetNew <= block.size){
+                mOffset = offsetNew;
+                mBytesUsed += bytes;
+                return reinterpret_cast<void*>(aligned);
+            }
+        }
+        addBlock(bytes + alignment);
+        return allocate(bytes, alignment);
+    }
+    
+    void MonotonicArena::reset(){
+        // Coalesce blocks into one so that the next update is served from a single block.
+        if(mBlocks.size()>1){
+            size_t total = 0;
+            for(const auto& block: mBlocks){
+                total += block.size;
+            }
+            mBlocks.clear();
+            mBlocks.push_back(Block{std::unique_ptr<char[]>(new char[total]), total});
+            mBlockSize = std::max(mBlockSize, total);
+        }
+        mOffset = 0;
+        mBytesUsed = 0;
+    }
+    
+    size_t MonotonicArena::bytesUsed() const{
+        return mBytesUsed;
+    }
+    
+    bool MonotonicArena::isActiveInCurrentThread() const{
+        return 0<mDepth && mOwner.load()==std::this_thread::get_id();
+    }
+    
+    size_t MonotonicArena::capacity() const{
+        size_t total = 0;
+        for(const auto& block: mBlocks){
+            total += block.size;
+        }
+        return total;
+    }
+    
+}
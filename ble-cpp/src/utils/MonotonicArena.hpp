@@ -0,0 +1,147 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef MonotonicArena_hpp
+#define MonotonicArena_hpp
+
+#include <stdio.h>
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include <atomic>
+#include <thread>
+
+namespace loc{
+    
+    /**
+     Monotonic arena for transient data created while processing one sensor input.
+     Memory is released only by reset(), which keeps the allocated capacity for the next input.
+     **/
+    class MonotonicArena{
+    public:
+        using Ptr = std::shared_ptr<MonotonicArena>;
+        
+        // Resets the arena when the outermost scope is closed.
+        class Scope{
+        public:
+            Scope(MonotonicArena& arena);
+            ~Scope();
+            Scope(const Scope&) = delete;
+            Scope& operator=(const Scope&) = delete;
+        private:
+            MonotonicArena& mArena;
+        };
+        
+        // Rewinds the arena to the state at construction on destruction, so that data allocated in between can be
+        // reused by repeated short-lived computations within one scope. Objects allocated in between must be destroyed
+        // first. Does nothing for a null arena or when a block has been added in between.
+        class Mark{
+        public:
+            Mark(MonotonicArena* arena);
+            ~Mark();
+            Mark(const Mark&) = delete;
+            Mark& operator=(const Mark&) = delete;
+        private:
+            MonotonicArena* mArena;
+            size_t mNBlocks = 0;
+            size_t mOffset = 0;
+            size_t mBytesUsed = 0;
+        };
+        
+        MonotonicArena(size_t initialBlockSize = 64*1024);
+        ~MonotonicArena() = default;
+        MonotonicArena(const MonotonicArena&) = delete;
+        MonotonicArena& operator=(const MonotonicArena&) = delete;
+        
+        void* allocate(size_t bytes, size_t alignment = alignof(std::max_align_t));
+        void reset();
+        
+        size_t bytesUsed() const;
+        size_t capacity() const;
+        
+        // True when the calling thread has opened the outermost scope. Other threads must not allocate from the arena.
+        bool isActiveInCurrentThread() const;
+        
+    private:
+        struct Block{
+            std::unique_ptr<char[]> data;
+            size_t size;
+        };
+        std::vector<Block> mBlocks;
+        size_t mBlockSize;
+        size_t mOffset = 0;
+        size_t mBytesUsed = 0;
+        std::atomic<int> mDepth{0};
+        std::atomic<std::thread::id> mOwner{std::thread::id()};
+        
+        void addBlock(size_t minSize);
+    };
+    
+    /**
+     STL allocator drawing from a MonotonicArena. Falls back to the global heap when no arena is set.
+     **/
+    template<class T>
+    class ArenaAllocator{
+    public:
+        using value_type = T;
+        
+        ArenaAllocator(MonotonicArena* arena = nullptr) noexcept : mArena(arena){}
+        template<class U>
+        ArenaAllocator(const ArenaAllocator<U>& other) noexcept : mArena(other.arena()){}
+        
+        T* allocate(size_t n){
+            if(mArena){
+                return static_cast<T*>(mArena->allocate(n*sizeof(T), alignof(T)));
+            }
+            return static_cast<T*>(::operator new(n*sizeof(T)));
+        }
+        
+        void deallocate(T* p, size_t n) noexcept{
+            if(!mArena){
+                ::operator delete(p);
+            }
+        }
+        
+        MonotonicArena* arena() const noexcept{
+            return mArena;
+        }
+        
+    private:
+        MonotonicArena* mArena;
+    };
+    
+    template<class T, class U>
+    bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) noexcept{
+        return a.arena() == b.arena();
+    }
+    
+    template<class T, class U>
+    bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) noexcept{
+        return !(a == b);
+    }
+    
+    template<class T>
+    using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+    
+}
+
+#endif /* MonotonicArena_hpp */
@@ -0,0 +1,187 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2016  IBM Corporation and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef SPSCQueue_hpp
+#define SPSCQueue_hpp
+
+#include <stdio.h>
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace loc{
+    
+    /**
+     Bounded lock-free queue for exactly one producer thread and one consumer thread.
+     push() fails instead of blocking when the queue is full.
+     **/
+    template<class T>
+    class SPSCQueue{
+    public:
+        SPSCQueue(size_t capacity){
+            size_t n = 2;
+            while(n < capacity+1){
+                n <<= 1;
+            }
+            mMask = n-1;
+            mSlots.resize(n);
+        }
+        
+        ~SPSCQueue(){
+            size_t head = mHead.load(std::memory_order_relaxed);
+            size_t tail = mTail.load(std::memory_order_relaxed);
+            for(; head != tail; head = (head+1) & mMask){
+                reinterpret_cast<T*>(&mSlots[head])->~T();
+            }
+        }
+        
+        SPSCQueue(const SPSCQueue&) = delete;
+        SPSCQueue& operator=(const SPSCQueue&) = delete;
+        
+        // producer side
+        bool push(const T& item){
+            size_t tail = mTail.load(std::memory_order_relaxed);
+            size_t next = (tail+1) & mMask;
+            if(next == mHead.load(std::memory_order_acquire)){
+                return false;
+            }
+            new (&mSlots[tail]) T(item);
+            mTail.store(next, std::memory_order_release);
+            return true;
+        }
+        
+        // consumer side
+        bool pop(T& item){
+            size_t head = mHead.load(std::memory_order_relaxed);
+            if(head == mTail.load(std::memory_order_acquire)){
+                return false;
+            }
+            T* slot = reinterpret_cast<T*>(&mSlots[head]);
+            item = std::move(*slot);
+            slot->~T();
+            mHead.store((head+1) & mMask, std::memory_order_release);
+            return true;
+        }
+        
+        // consumer side; calls func for every queued item in FIFO order and returns the number of items consumed
+        template<class F>
+        size_t consumeAll(F func){
+            size_t head = mHead.load(std::memory_order_relaxed);
+            size_t tail = mTail.load(std::memory_order_acquire);
+            size_t n = 0;
+            for(; head != tail; head = (head+1) & mMask, n++){
+                T* slot = reinterpret_cast<T*>(&mSlots[head]);
+                func(*slot);
+                slot->~T();
+                mHead.store((head+1) & mMask, std::memory_order_release);
+            }
+            return n;
+        }
+        
+        // approximate when called concurrently with push/pop
+        size_t size() const{
+            size_t head = mHead.load(std::memory_order_acquire);
+            size_t tail = mTail.load(std::memory_order_acquire);
+            return (tail - head) & mMask;
+        }
+        
+        size_t capacity() const{
+            return mMask;
+        }
+        
+    private:
+        using Slot = typename std::aligned_storage<sizeof(T), alignof(T)>::type;
+        std::vector<Slot> mSlots;
+        size_t mMask;
+        // head and tail are kept on separate cache lines to avoid false sharing between the two threads.
+        alignas(64) std::atomic<size_t> mHead{0};
+        alignas(64) std::atomic<size_t> mTail{0};
+    };
+    
+    /**
+     Wait-free single-item slot for exactly one producer thread and one consumer thread (triple buffering).
+     put() replaces the item that has not been taken yet, so the consumer always takes the latest one.
+     **/
+    template<class T>
+    class SPSCLatestSlot{
+    public:
+        SPSCLatestSlot() = default;
+        
+        ~SPSCLatestSlot(){
+            for(int i=0; i<3; i++){
+                if(mConstructed[i]){
+                    reinterpret_cast<T*>(&mBuffers[i])->~T();
+                }
+            }
+        }
+        
+        SPSCLatestSlot(const SPSCLatestSlot&) = delete;
+        SPSCLatestSlot& operator=(const SPSCLatestSlot&) = delete;
+        
+        // producer side; returns true if an item that had not been taken was replaced
+        bool put(const T& item){
+            if(mConstructed[mBack]){
+                *reinterpret_cast<T*>(&mBuffers[mBack]) = item;
+            }else{
+                new (&mBuffers[mBack]) T(item);
+                mConstructed[mBack] = true;
+            }
+            unsigned prev = mMiddle.exchange(mBack | dirtyBit, std::memory_order_acq_rel);
+            mBack = prev & indexMask;
+            return (prev & dirtyBit) != 0;
+        }
+        
+        // consumer side; calls func for the item if one has been put since the last call
+        template<class F>
+        bool consume(F func){
+            if(!pending()){
+                return false;
+            }
+            unsigned prev = mMiddle.exchange(mFront, std::memory_order_acq_rel);
+            mFront = prev & indexMask;
+            func(*reinterpret_cast<T*>(&mBuffers[mFront]));
+            return true;
+        }
+        
+        bool pending() const{
+            return (mMiddle.load(std::memory_order_acquire) & dirtyBit) != 0;
+        }
+        
+    private:
+        static constexpr unsigned indexMask = 3;
+        static constexpr unsigned dirtyBit = 4;
+        using Slot = typename std::aligned_storage<sizeof(T), alignof(T)>::type;
+        // Each buffer is owned by the producer (back), the consumer (front) or neither (middle);
+        // the ownership and the constructed flag of a buffer are handed over by the exchange of mMiddle.
+        Slot mBuffers[3];
+        bool mConstructed[3] = {false, false, false};
+        alignas(64) unsigned mBack = 0;
+        alignas(64) unsigned mFront = 2;
+        alignas(64) std::atomic<unsigned> mMiddle{1};
+    };
+    
+}
+
+#endif /* SPSCQueue_hpp */